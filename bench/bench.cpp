@@ -0,0 +1,387 @@
+/*
+ * bench.cpp
+ */
+
+// timings of loading and rendering stages on bundled models, written as json
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "entities/geometry/object.h"
+#include "entities/rendering/buffer.h"
+#include "entities/rendering/output.h"
+#include "entities/rendering/rasterizer.h"
+#include "entities/rendering/renderer.h"
+#include "entities/rendering/transform.h"
+#include "utils/algorithms.h"
+#include "config.h"
+#include "version.h"
+
+inline constexpr size_t BENCH_MIN_ITERATIONS = 5;
+inline constexpr double BENCH_STAGE_SECONDS = 0.25;    // time spent repeating each stage by default
+inline constexpr unsigned int BENCH_SIZES[][2] = {{80, 24}, {160, 48}, {320, 96}};
+inline constexpr size_t BENCH_POLYGONS[] = {4, 8, 32, 128};
+
+// one measured stage
+class Result {
+public:
+    std::string stage;
+    std::string model;      // name of model or input
+    std::string size;       // buffer WxH, empty for stages without buffer
+    size_t iterations = 0;
+    double min_ms = 0.0;
+    double mean_ms = 0.0;
+};
+
+class BenchArgs {
+public:
+    std::filesystem::path models = BENCH_MODELS_DIR;
+    std::filesystem::path out;      // empty for standard output
+    double seconds = BENCH_STAGE_SECONDS;
+    unsigned int threads = 1;
+};
+
+// helper functions
+
+static void print_help()
+{
+    std::cout <<
+        "Usage: " << APP_NAME << "_bench [OPTIONS]\n"
+        "\n"
+        "Times loading and rendering stages on every .obj of models directory, results are json\n"
+        "\n"
+        "Options:\n"
+        "  -d, --models <dir>   Models to load (default " << BENCH_MODELS_DIR << ")\n"
+        "  -s, --seconds <s>    Time spent on each stage (default " << BENCH_STAGE_SECONDS << ")\n"
+        "  -t, --threads <n>    Threads for parsing and rasterizing, 0 for all cores (default 1)\n"
+        "  -o, --out <file>     Write results to file instead of standard output\n"
+        "  -h, --help           Print help\n";
+}
+
+static BenchArgs parse_args(const int argc, char **argv)
+{
+    BenchArgs a;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string_view arg{argv[i]};
+
+        if (arg == "-h" || arg == "--help")
+        {
+            print_help();
+            std::exit(0);
+        }
+
+        if (i + 1 >= argc)
+        {
+            std::cerr << "error: missing value for " << arg << '\n';
+            std::exit(1);
+        }
+
+        const std::string_view value{argv[++i]};
+        bool valid = true;
+
+        if (arg == "-d" || arg == "--models")
+        {
+            a.models = value;
+        }
+        else if (arg == "-o" || arg == "--out")
+        {
+            a.out = value;
+        }
+        else if (arg == "-s" || arg == "--seconds")
+        {
+            const auto [ptr, ec] = std::from_chars(value.data(), value.data() + value.size(), a.seconds);
+            valid = ec == std::errc() && ptr == value.data() + value.size() && a.seconds > 0.0;
+        }
+        else if (arg == "-t" || arg == "--threads")
+        {
+            const auto [ptr, ec] = std::from_chars(value.data(), value.data() + value.size(), a.threads);
+            valid = ec == std::errc() && ptr == value.data() + value.size();
+        }
+        else
+        {
+            std::cerr << "unknown option: " << arg << '\n';
+            std::cerr << "type '--help' for usage\n";
+            std::exit(1);
+        }
+
+        if (!valid)
+        {
+            std::cerr << "error: invalid value for " << arg << ": " << value << '\n';
+            std::exit(1);
+        }
+    }
+
+    return a;
+}
+
+// runs task until time is spent and minimum count is reached, setup before every run is not timed
+static Result measure(const std::string &stage, const std::string &model, const std::string &size, const double seconds, const std::function<void()> &setup, const std::function<void()> &task)
+{
+    using Clock = std::chrono::steady_clock;
+
+    Result result{stage, model, size};
+    double total = 0.0;
+    result.min_ms = INFINITY;
+
+    while (result.iterations < BENCH_MIN_ITERATIONS || total < seconds * 1000.0)
+    {
+        if (setup)
+        {
+            setup();
+        }
+
+        const auto start = Clock::now();
+        task();
+        const double ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+        result.min_ms = std::min(result.min_ms, ms);
+        total += ms;
+        result.iterations++;
+    }
+
+    result.mean_ms = total / static_cast<double>(result.iterations);
+    return result;
+}
+
+// polygon of n corners on unit circle, every other corner pulled in when concave
+static std::vector<Vec3> polygon(const size_t n, const bool concave)
+{
+    std::vector<Vec3> points;
+
+    for (size_t i = 0; i < n; i++)
+    {
+        const float angle = 2.0f * PI * static_cast<float>(i) / static_cast<float>(n);
+        const float radius = concave && i % 2 ? 0.5f : 1.0f;
+        points.emplace_back(radius * std::cos(angle), radius * std::sin(angle), 0.0f);
+    }
+
+    return points;
+}
+
+// string as json literal, quotes, backslashes and control characters are escaped
+static std::string json_string(const std::string_view s)
+{
+    std::string out = "\"";
+
+    for (const char c : s)
+    {
+        if (c == '"' || c == '\\')
+        {
+            out += '\\';
+            out += c;
+        }
+        else if (static_cast<unsigned char>(c) < 0x20)
+        {
+            constexpr char hex[] = "0123456789abcdef";
+            out += "\\u00";
+            out += hex[c >> 4];
+            out += hex[c & 0xf];
+        }
+        else
+        {
+            out += c;
+        }
+    }
+
+    return out + '"';
+}
+
+static void write_json(std::ostream &out, const std::vector<Result> &results, const BenchArgs &args)
+{
+    out << std::fixed << std::setprecision(6);
+    out << "{\n";
+    out << "  \"version\": " << json_string(APP_VERSION) << ",\n";
+    out << "  \"compiler\": " << json_string(__VERSION__) << ",\n";
+#ifdef __OPTIMIZE__
+    out << "  \"optimized\": true,\n";
+#else
+    out << "  \"optimized\": false,\n";
+#endif
+    out << "  \"threads\": " << args.threads << ",\n";
+    out << "  \"transform_kernel\": " << json_string(VertexTransform::kernel_name()) << ",\n";
+    out << "  \"results\": [\n";
+
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        const Result &r = results[i];
+        out << "    {\"stage\": " << json_string(r.stage) << ", \"model\": " << json_string(r.model) << ", \"size\": " << json_string(r.size)
+            << ", \"iterations\": " << r.iterations << ", \"min_ms\": " << r.min_ms << ", \"mean_ms\": " << r.mean_ms << '}'
+            << (i + 1 < results.size() ? "," : "") << '\n';
+    }
+
+    out << "  ]\n";
+    out << "}\n";
+}
+
+// stages of one model, loaded as interactive mode does
+static void bench_model(const std::filesystem::path &path, const BenchArgs &args, std::vector<Result> &results)
+{
+    const std::string name = path.stem().string();
+    const double seconds = args.seconds;
+
+    Object obj;
+    if (!obj.load(path.string(), true, args.threads))
+    {
+        std::cerr << "warning: skipping " << path.string() << std::endl;
+        return;
+    }
+
+    // warnings were shown by first load already
+    std::streambuf *const cerr_buf = std::cerr.rdbuf(nullptr);
+    results.push_back(measure("load", name, "", seconds, {}, [&] {
+        Object loaded;
+        loaded.load(path.string(), true, args.threads);
+    }));
+    std::cerr.rdbuf(cerr_buf);
+    std::cerr.clear();
+
+    Object copy;
+    results.push_back(measure("normalize", name, "", seconds, [&] { copy = obj; }, [&] { copy.normalize(); }));
+
+    obj.normalize();
+    obj.pack();
+
+    const int null_fd = ::open("/dev/null", O_WRONLY);
+    const std::vector<Material> *materials = obj.materials.empty() ? nullptr : &obj.materials;
+
+    for (const auto &[width, height] : BENCH_SIZES)
+    {
+        const std::string size = std::to_string(width) + "x" + std::to_string(height);
+        const float logical_y = 2.0f;
+        const float logical_x = logical_y * static_cast<float>(width) / (static_cast<float>(height) * CHAR_ASPECT_RATIO);
+
+        Buffer buf(width, height, logical_x, logical_y);
+        TileRasterizer rasterizer(args.threads);
+        Camera cam;
+        const Light light;
+
+        // camera turns between runs, timings cover whole orbit rather than one view
+        results.push_back(measure("clear", name, size, seconds, {}, [&] { buf.clear(); }));
+
+        const PlanarPositions &positions = obj.packed->positions;
+        PlanarPositions screen;
+        results.push_back(measure("vertex_pass", name, size, seconds, [&] { cam.rotate_left(); }, [&] {
+            // normalized mesh lands around middle of screen already, renderer centers it by hierarchy bounds beforehand
+            VertexTransform::orbit(cam, logical_x, logical_y).apply(positions, nullptr, screen);
+        }));
+
+        // faces straight into buffer, without culling and rasterizer
+        const std::vector<uint32_t> &indices = obj.packed->indices;
+        results.push_back(measure("draw_projection", name, size, seconds, [&] { buf.clear(); }, [&] {
+            for (size_t i = 0; i + 2 < indices.size(); i += 3)
+            {
+                buf.draw_projection(Projection(screen[indices[i]], screen[indices[i + 1]], screen[indices[i + 2]], '#'), '#', 0);
+            }
+        }));
+
+        // face pass runs inside render only, renderer times it on every run
+        RenderTimings timings;
+        Result face{"face_pass", name, size};
+        face.min_ms = INFINITY;
+
+        results.push_back(measure("render", name, size, seconds, [&] { cam.rotate_left(); buf.clear(); }, [&] {
+            Renderer::render(buf, obj, cam, light, false, true, 0, &rasterizer, &timings);
+            face.min_ms = std::min(face.min_ms, timings.face_ms);
+            face.mean_ms += timings.face_ms;
+            face.iterations++;
+        }));
+
+        face.mean_ms /= static_cast<double>(face.iterations);
+        results.push_back(face);
+
+        // output of rendered frames, terminal gets whole frame or changes against previous one
+        results.push_back(measure("output_full", name, size, seconds, {}, [&] {
+            TerminalOutput output(null_fd, materials);
+            output.present(buf, {});
+        }));
+
+        Buffer next = buf;
+        cam.rotate_left();
+        next.clear();
+        Renderer::render(next, obj, cam, light, false, true, 0, &rasterizer);
+
+        TerminalOutput output(null_fd, materials);
+        bool flip = false;
+        results.push_back(measure("output_diff", name, size, seconds, {}, [&] {
+            output.present(flip ? buf : next, {});
+            flip = !flip;
+        }));
+
+        TextOutput text(null_fd, materials);
+        results.push_back(measure("output_text", name, size, seconds, {}, [&] { text.present(buf, {}); }));
+    }
+
+    ::close(null_fd);
+}
+
+// main
+int main(int argc, char **argv)
+{
+    const BenchArgs args = parse_args(argc, argv);
+
+    std::vector<std::filesystem::path> models;
+    std::error_code ec;
+    for (const auto &entry : std::filesystem::directory_iterator(args.models, ec))
+    {
+        if (entry.path().extension() == ".obj")
+        {
+            models.push_back(entry.path());
+        }
+    }
+
+    if (models.empty())
+    {
+        std::cerr << "error: no .obj files in " << args.models.string() << std::endl;
+        return 1;
+    }
+
+    std::ranges::sort(models);
+
+    std::vector<Result> results;
+
+    for (const size_t n : BENCH_POLYGONS)
+    {
+        for (const bool concave : {false, true})
+        {
+            const std::vector<Vec3> points = polygon(n, concave);
+            const std::string name = (concave ? "concave-" : "convex-") + std::to_string(n);
+            results.push_back(measure("triangularize", name, "", args.seconds, {}, [&] { std::ignore = triangularize(points); }));
+        }
+    }
+
+    for (const auto &path : models)
+    {
+        bench_model(path, args, results);
+    }
+
+    if (args.out.empty())
+    {
+        write_json(std::cout, results, args);
+        return 0;
+    }
+
+    std::ofstream out(args.out);
+    write_json(out, results, args);
+
+    if (!out.flush())
+    {
+        std::cerr << "error: can't write file " << args.out.string() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
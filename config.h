@@ -4,12 +4,45 @@
 
 #pragma once
 
+#include <cstddef>
+
 // cli draw
 inline constexpr char CHARS_LUM[] = " .:-=+*#%@";
 inline constexpr float CHAR_ASPECT_RATIO = 2.0f;
 
+// output
+inline constexpr unsigned int TERMINAL_SKIP_CELLS = 4;  // unchanged cells rewritten rather than moving cursor over them
+
 // view
 inline constexpr float ANGLE_STEP = 5.0f;
 inline constexpr float ZOOM_STEP = 0.1f;
 inline constexpr float ZOOM_MIN = 0.10f;
 inline constexpr float ZOOM_MAX = 5.00f;
+
+// frames
+inline constexpr int FRAME_INTERVAL_MS = 33; // period of animation frames, also polls loading progress
+inline constexpr size_t FRAME_CACHE_MIB = 32;  // finished frames kept for revisited camera states
+inline constexpr unsigned int FRAME_MAX_SIDE = 2048;    // characters per side of --size and animation files
+
+// rasterization
+inline constexpr int RASTER_TILE_WIDTH = 32;         // cells per tile of parallel rasterizer
+inline constexpr int RASTER_TILE_HEIGHT = 16;
+inline constexpr int RASTER_SUBPIXEL_BITS = 8;      // fixed point precision of triangle vertices in cell
+inline constexpr float RASTER_GUARD_BAND = 32768.f; // cells around screen triangles may reach, farther ones are dropped
+inline constexpr int DEPTH_TILE_WIDTH = 8;          // cells per tile of hierarchical depth, divides raster tile
+inline constexpr int DEPTH_TILE_HEIGHT = 4;
+inline constexpr size_t DEPTH_BUCKETS = 256;        // depth slices faces are sorted into, front to back
+
+// loading
+inline constexpr size_t LOAD_CHUNK_SIZE = 1 << 18; // bytes of obj text per parsing task
+inline constexpr size_t LOAD_WAVE_CHUNKS = 4;       // chunks per parser thread between showing faces while loading
+inline constexpr size_t LOAD_QUEUE_BLOCKS = 4;      // decoded blocks buffered ahead of parser when streaming
+inline constexpr int LOAD_POLL_MS = 100;            // stalled input is checked for cancelling this often
+
+// level of detail
+inline constexpr size_t LOD_MIN_FACES = 512;    // coarsest level keeps at least this many faces
+inline constexpr size_t LOD_MAX_LEVELS = 8;
+
+// culling
+inline constexpr size_t BVH_LEAF_FACES = 64;    // faces per leaf of bounding volume hierarchy
+inline constexpr float BVH_CULL_VIEW = 0.5f;    // faces are culled when view shows less than this part of mesh bounds
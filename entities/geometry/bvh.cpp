@@ -0,0 +1,123 @@
+/*
+ * bvh.cpp
+ */
+
+#include "bvh.h"
+
+#include <algorithm>
+#include <limits>
+
+#include "packed.h"
+#include "config.h"
+
+// helper functions
+
+static void grow(Vec3 &min, Vec3 &max, const Vec3 &v)
+{
+    min = {std::min(min.x, v.x), std::min(min.y, v.y), std::min(min.z, v.z)};
+    max = {std::max(max.x, v.x), std::max(max.y, v.y), std::max(max.z, v.z)};
+}
+
+// spreads 10 bit cell of coordinate scaled to 0..1023 to every third bit
+static uint32_t spread_bits(const float scaled)
+{
+    auto v = static_cast<uint32_t>(std::clamp(scaled, 0.0f, 1023.0f));
+    v = (v | (v << 16)) & 0x030000ff;
+    v = (v | (v << 8)) & 0x0300f00f;
+    v = (v | (v << 4)) & 0x030c30c3;
+    v = (v | (v << 2)) & 0x09249249;
+    return v;
+}
+
+// builds subtree over faces order[begin, end) sorted along curve, halves are spatially coherent
+static uint32_t build_node(FaceBvh &bvh, const std::vector<Vec3> &positions, const std::vector<uint32_t> &indices, const std::vector<uint32_t> &order, const uint32_t begin, const uint32_t end, const int material)
+{
+    const auto index = static_cast<uint32_t>(bvh.nodes.size());
+    bvh.nodes.emplace_back();
+
+    constexpr float inf = std::numeric_limits<float>::max();
+    Vec3 min(inf, inf, inf), max(-inf, -inf, -inf);
+
+    if (end - begin <= BVH_LEAF_FACES)
+    {
+        for (uint32_t i = begin; i < end; i++)
+        {
+            for (int k = 0; k < 3; k++)
+            {
+                grow(min, max, positions[indices[3 * order[i] + k]]);
+            }
+        }
+
+        bvh.nodes[index] = {min, max, begin, end - begin, material};
+        return index;
+    }
+
+    const uint32_t middle = begin + (end - begin) / 2;
+    const uint32_t left = build_node(bvh, positions, indices, order, begin, middle, material);
+    const uint32_t right = build_node(bvh, positions, indices, order, middle, end, material);
+
+    // bounds of children
+    for (const uint32_t child : {left, right})
+    {
+        grow(min, max, bvh.nodes[child].min);
+        grow(min, max, bvh.nodes[child].max);
+    }
+
+    bvh.nodes[index] = {min, max, right, 0, material};
+    return index;
+}
+
+// methods
+
+FaceBvh::FaceBvh(const std::vector<Vec3> &positions, std::vector<uint32_t> &indices, const std::vector<MaterialRun> &runs, std::vector<uint32_t> &order)
+{
+    const size_t face_count = indices.size() / 3;
+
+    constexpr float inf = std::numeric_limits<float>::max();
+    Vec3 min(inf, inf, inf), max(-inf, -inf, -inf);
+
+    for (const auto &p : positions)
+    {
+        grow(min, max, p);
+    }
+
+    // faces of every run sorted by morton code of centroid
+    const Vec3 extent = max - min;
+    const float scale = 1023.0f / std::max({extent.x, extent.y, extent.z, 1e-12f});
+
+    std::vector<uint64_t> keys(face_count);
+    for (size_t i = 0; i < face_count; i++)
+    {
+        const Vec3 c = (positions[indices[3 * i]] + positions[indices[3 * i + 1]] + positions[indices[3 * i + 2]]) * (1.0f / 3.0f) - min;
+        const uint32_t code = spread_bits(c.x * scale) | (spread_bits(c.y * scale) << 1) | (spread_bits(c.z * scale) << 2);
+
+        keys[i] = (static_cast<uint64_t>(code) << 32) | i;
+    }
+
+    order.resize(face_count);
+
+    for (const auto &run : runs)
+    {
+        std::sort(keys.begin() + run.first, keys.begin() + run.first + run.count);
+
+        for (uint32_t i = run.first; i < run.first + run.count; i++)
+        {
+            order[i] = static_cast<uint32_t>(keys[i]);
+        }
+
+        roots.push_back(build_node(*this, positions, indices, order, run.first, run.first + run.count, run.material));
+    }
+
+    // faces in leaf order
+    std::vector<uint32_t> reordered(indices.size());
+    for (size_t i = 0; i < face_count; i++)
+    {
+        std::copy_n(indices.begin() + 3 * order[i], 3, reordered.begin() + 3 * i);
+    }
+    indices = std::move(reordered);
+}
+
+size_t FaceBvh::bytes() const
+{
+    return nodes.size() * sizeof(BvhNode) + roots.size() * sizeof(uint32_t);
+}
@@ -0,0 +1,37 @@
+/*
+ * bvh.h
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "utils/mathematics.h"
+
+class MaterialRun;
+
+// node of bounding volume hierarchy over faces
+class BvhNode {
+public:
+    Vec3 min, max;              // bounds of vertices of faces below node
+    uint32_t first = 0;         // leaf - first face, inner node - second child, first child follows node
+    uint32_t count = 0;         // faces of leaf, 0 for inner node
+    int material = -1;          // leaf - material of its faces
+
+    [[nodiscard]] bool leaf() const { return count > 0; }
+};
+
+// bounding volume hierarchy over faces, one tree per material run, faces of every leaf are contiguous
+class FaceBvh {
+public:
+    std::vector<BvhNode> nodes;
+    std::vector<uint32_t> roots;    // tree of every material run
+
+    FaceBvh() = default;
+
+    // faces of every run are reordered in indices, order receives former index of every face
+    FaceBvh(const std::vector<Vec3> &positions, std::vector<uint32_t> &indices, const std::vector<MaterialRun> &runs, std::vector<uint32_t> &order);
+
+    [[nodiscard]] size_t bytes() const;
+};
@@ -0,0 +1,295 @@
+/*
+ * cache.cpp
+ */
+
+#include "cache.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+
+#include "utils/mapped_file.h"
+
+// file layout, native byte order:
+// header | vertices (3 x f32) | faces (3 x u32, i32 material or -1) | materials (u32 name length, name, 3 x f32)
+// | shading normals (3 x f32 per face, only when file normals were loaded and present)
+
+inline constexpr char CACHE_MAGIC[4] = {'O', 'B', 'J', 'C'};
+inline constexpr uint32_t CACHE_VERSION = 2;
+
+struct CacheHeader {
+    char magic[4];
+    uint32_t version;           // format version, also detects byte order
+    uint64_t source_size;       // size of obj file
+    int64_t source_mtime;       // modification time of obj file
+    uint64_t source_hash;       // content hash of obj file
+    uint32_t color_support;     // materials were loaded
+    uint32_t file_normals;      // vn records were loaded
+    uint64_t vertex_count;
+    uint64_t face_count;
+    uint64_t material_count;
+    uint64_t normal_count;      // shading normals, 0 or face count
+};
+
+struct CacheFace {
+    uint32_t indices[3];
+    int32_t material;
+};
+
+static_assert(sizeof(Vec3) == 3 * sizeof(float), "vertices are stored as raw floats");
+
+// helper functions
+
+// stat of source file, false if missing
+static bool source_stat(const std::filesystem::path &obj_filename, uint64_t &size, int64_t &mtime)
+{
+    std::error_code ec;
+    size = std::filesystem::file_size(obj_filename, ec);
+    if (ec)
+        return false;
+
+    const auto time = std::filesystem::last_write_time(obj_filename, ec);
+    if (ec)
+        return false;
+
+    mtime = static_cast<int64_t>(time.time_since_epoch().count());
+    return true;
+}
+
+// content hash of source file
+static std::optional<uint64_t> source_hash(const std::filesystem::path &obj_filename)
+{
+    MappedFile file;
+    if (!file.open(obj_filename.string()))
+        return std::nullopt;
+
+    return hash_bytes(file.data(), file.size());
+}
+
+// bounds checked read from mapped cache
+static bool take(std::string_view &data, void *out, size_t size)
+{
+    if (data.size() < size)
+        return false;
+
+    std::memcpy(out, data.data(), size);
+    data.remove_prefix(size);
+    return true;
+}
+
+// stores new modification time of source in header, content was found unchanged
+static void refresh_mtime(const std::filesystem::path &path, int64_t mtime)
+{
+    std::fstream file(path, std::ios::binary | std::ios::in | std::ios::out);
+    if (!file)
+        return;
+
+    file.seekp(offsetof(CacheHeader, source_mtime));
+    file.write(reinterpret_cast<const char *>(&mtime), sizeof(mtime));
+}
+
+// ObjectCache methods
+
+std::filesystem::path ObjectCache::local_path(const std::filesystem::path &obj_filename, bool color_support, bool file_normals)
+{
+    auto path = obj_filename;
+    path += color_support ? ".c" : "";
+    path += file_normals ? ".n" : "";
+    path += ".objc";
+    return path;
+}
+
+std::filesystem::path ObjectCache::user_path(const std::filesystem::path &obj_filename, bool color_support, bool file_normals)
+{
+    std::filesystem::path dir;
+
+    if (const char *xdg = std::getenv("XDG_CACHE_HOME"); xdg && *xdg)
+        dir = std::filesystem::path(xdg) / "objcurses";
+    else if (const char *home = std::getenv("HOME"); home && *home)
+        dir = std::filesystem::path(home) / ".cache" / "objcurses";
+    else
+        return {};
+
+    // keyed by absolute path of model
+    std::error_code ec;
+    const std::string key = std::filesystem::weakly_canonical(std::filesystem::absolute(obj_filename), ec).string();
+
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016llx%s%s.objc", static_cast<unsigned long long>(hash_bytes(key.data(), key.size())), color_support ? "-c" : "", file_normals ? "-n" : "");
+    return dir / name;
+}
+
+bool ObjectCache::load(Object &obj, const std::filesystem::path &obj_filename, bool color_support, bool file_normals)
+{
+    uint64_t size;
+    int64_t mtime;
+    if (!source_stat(obj_filename, size, mtime))
+        return false;
+
+    for (const auto &path : {local_path(obj_filename, color_support, file_normals), user_path(obj_filename, color_support, file_normals)})
+    {
+        MappedFile file;
+        if (path.empty() || !file.open(path.string()))
+            continue;
+
+        std::string_view data = file.view();
+
+        CacheHeader header {};
+        if (!take(data, &header, sizeof(header)) ||
+            std::memcmp(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) != 0 ||
+            header.version != CACHE_VERSION ||
+            header.color_support != static_cast<uint32_t>(color_support) ||
+            header.file_normals != static_cast<uint32_t>(file_normals) ||
+            (header.normal_count != 0 && header.normal_count != header.face_count) ||
+            header.source_size != size)
+        {
+            continue;
+        }
+
+        // touched but maybe unchanged, content decides
+        const bool touched = header.source_mtime != mtime;
+        if (touched && source_hash(obj_filename) != header.source_hash)
+            continue;
+
+        if (header.vertex_count > data.size() / sizeof(Vec3) || header.face_count > data.size() / sizeof(CacheFace) ||
+            data.size() < header.vertex_count * sizeof(Vec3) + header.face_count * sizeof(CacheFace))
+        {
+            continue;
+        }
+
+        Object cached;
+
+        cached.vertices.resize(header.vertex_count);
+        take(data, cached.vertices.data(), header.vertex_count * sizeof(Vec3));
+
+        bool valid = true;
+        cached.faces.reserve(header.face_count);
+        for (uint64_t i = 0; i < header.face_count; i++)
+        {
+            CacheFace f {};
+            take(data, &f, sizeof(f));
+
+            if (f.indices[0] >= header.vertex_count || f.indices[1] >= header.vertex_count || f.indices[2] >= header.vertex_count ||
+                f.material >= static_cast<int64_t>(header.material_count))
+            {
+                valid = false;
+                break;
+            }
+
+            cached.faces.emplace_back(f.indices[0], f.indices[1], f.indices[2], f.material < 0 ? std::nullopt : std::optional<int>(f.material));
+        }
+
+        for (uint64_t i = 0; valid && i < header.material_count; i++)
+        {
+            uint32_t length = 0;
+            Vec3 diffuse;
+            if (!take(data, &length, sizeof(length)) || data.size() < length + sizeof(Vec3))
+            {
+                valid = false;
+                break;
+            }
+
+            std::string name(data.substr(0, length));
+            data.remove_prefix(length);
+            take(data, &diffuse, sizeof(diffuse));
+            cached.materials.emplace_back(name, diffuse);
+        }
+
+        if (valid && header.normal_count > 0)
+        {
+            cached.shading_normals.resize(header.normal_count);
+            valid = take(data, cached.shading_normals.data(), header.normal_count * sizeof(Vec3));
+        }
+
+        if (!valid || cached.vertices.empty() || cached.faces.empty())
+            continue;
+
+        // later launches skip hashing again
+        if (touched)
+        {
+            file.close();
+            refresh_mtime(path, mtime);
+        }
+
+        obj = std::move(cached);
+        return true;
+    }
+
+    return false;
+}
+
+bool ObjectCache::save(const Object &obj, const std::filesystem::path &obj_filename, bool color_support, bool file_normals)
+{
+    CacheHeader header {};
+    std::memcpy(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+    header.version = CACHE_VERSION;
+    header.color_support = color_support;
+    header.vertex_count = obj.vertices.size();
+    header.face_count = obj.faces.size();
+    header.material_count = obj.materials.size();
+    header.file_normals = file_normals;
+    header.normal_count = obj.shading_normals.size();
+
+    const auto hash = source_hash(obj_filename);
+    if (!hash || !source_stat(obj_filename, header.source_size, header.source_mtime))
+        return false;
+    header.source_hash = *hash;
+
+    std::vector<CacheFace> faces;
+    faces.reserve(obj.faces.size());
+    for (const auto &f : obj.faces)
+    {
+        faces.push_back({{f.indices[0], f.indices[1], f.indices[2]}, f.material ? *f.material : -1});
+    }
+
+    // user cache directory first, model directory as fallback
+    for (const auto &path : {user_path(obj_filename, color_support, file_normals), local_path(obj_filename, color_support, file_normals)})
+    {
+        if (path.empty())
+            continue;
+
+        std::error_code ec;
+        std::filesystem::create_directories(path.parent_path(), ec);
+
+        // written aside and renamed, readers never see partial file
+        auto tmp = path;
+        tmp += ".tmp";
+
+        {
+            std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+            if (!out)
+                continue;
+
+            out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+            out.write(reinterpret_cast<const char *>(obj.vertices.data()), static_cast<std::streamsize>(obj.vertices.size() * sizeof(Vec3)));
+            out.write(reinterpret_cast<const char *>(faces.data()), static_cast<std::streamsize>(faces.size() * sizeof(CacheFace)));
+
+            for (const auto &m : obj.materials)
+            {
+                const auto length = static_cast<uint32_t>(m.material_name.size());
+                out.write(reinterpret_cast<const char *>(&length), sizeof(length));
+                out.write(m.material_name.data(), length);
+                out.write(reinterpret_cast<const char *>(&m.diffuse), sizeof(m.diffuse));
+            }
+
+            out.write(reinterpret_cast<const char *>(obj.shading_normals.data()), static_cast<std::streamsize>(obj.shading_normals.size() * sizeof(Vec3)));
+
+            if (!out.flush())
+            {
+                std::filesystem::remove(tmp, ec);
+                continue;
+            }
+        }
+
+        std::filesystem::rename(tmp, path, ec);
+        if (!ec)
+            return true;
+
+        std::filesystem::remove(tmp, ec);
+    }
+
+    return false;
+}
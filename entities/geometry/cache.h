@@ -0,0 +1,24 @@
+/*
+ * cache.h
+ */
+
+#pragma once
+
+#include <filesystem>
+#include <string>
+
+#include "object.h"
+
+// persistent binary cache (.objc) of loaded and normalized objects
+class ObjectCache {
+public:
+    // load cached object if it still matches source file and load options
+    static bool load(Object &obj, const std::filesystem::path &obj_filename, bool color_support, bool file_normals);
+
+    // store loaded object, false if no location is writable
+    static bool save(const Object &obj, const std::filesystem::path &obj_filename, bool color_support, bool file_normals);
+
+private:
+    static std::filesystem::path local_path(const std::filesystem::path &obj_filename, bool color_support, bool file_normals); // next to model
+    static std::filesystem::path user_path(const std::filesystem::path &obj_filename, bool color_support, bool file_normals);  // in user cache directory
+};
@@ -0,0 +1,252 @@
+/*
+ * loader.cpp
+ */
+
+#include "loader.h"
+
+#include "cache.h"
+#include "lod.h"
+
+// helper functions
+
+static float max_extent(const Vec3 &vmin, const Vec3 &vmax)
+{
+    return std::max({vmax.x - vmin.x, vmax.y - vmin.y, vmax.z - vmin.z, 1e-6f});
+}
+
+// Orientation methods
+
+void Orientation::apply(Object &obj) const
+{
+    // flip faces winding order
+    if (flip_faces)
+        obj.flip_faces();
+
+    // invert along axes
+    if (invert_x)
+        obj.invert_x();
+
+    if (invert_y)
+        obj.invert_y();
+
+    if (invert_z)
+        obj.invert_z();
+}
+
+bool Orientation::flips_winding() const
+{
+    return flip_faces ^ invert_x ^ invert_y ^ invert_z;
+}
+
+Vec3 Orientation::signs() const
+{
+    return {invert_x ? -1.0f : 1.0f, invert_y ? -1.0f : 1.0f, invert_z ? -1.0f : 1.0f};
+}
+
+// BackgroundLoader methods
+
+BackgroundLoader::~BackgroundLoader()
+{
+    stop();
+}
+
+void BackgroundLoader::start(const std::filesystem::path &obj_filename, const LoadOptions &options)
+{
+    stop();
+
+    display = Object();
+    opts = options;
+    welded.reset();
+    raw_count = 0;
+
+    finished = false;
+    settled = false;
+    error = false;
+    cancel = false;
+    fraction = 0.0f;
+
+    worker = std::thread(&BackgroundLoader::run, this, obj_filename);
+}
+
+void BackgroundLoader::stop()
+{
+    cancel = true;
+
+    if (worker.joinable())
+    {
+        worker.join();
+    }
+}
+
+void BackgroundLoader::wait()
+{
+    if (worker.joinable())
+    {
+        worker.join();
+    }
+}
+
+void BackgroundLoader::run(const std::filesystem::path obj_filename)
+{
+    Object obj;
+
+    // standard input has nothing to key cache on
+    if (obj_filename == "-")
+    {
+        opts.use_cache = false;
+    }
+
+    // cached object is already normalized, otherwise parse
+    if (!opts.use_cache || opts.rebuild_cache || !ObjectCache::load(obj, obj_filename, opts.color_support, opts.file_normals))
+    {
+        if (!load(obj, obj_filename))
+        {
+            error = !cancel;
+            finished = true;
+            settled = true;
+            changes++;
+            return;
+        }
+    }
+
+    publish(std::move(obj));
+
+    // display object is immutable from now on apart from levels and layout, read without lock
+    std::vector<MeshLevel> levels;
+    if (opts.levels)
+    {
+        levels = build_levels(display, &cancel);
+    }
+
+    std::lock_guard lock(mutex);
+
+    if (opts.levels)
+    {
+        display.levels = std::move(levels);
+    }
+
+    if (opts.pack)
+    {
+        display.pack();
+    }
+
+    if (opts.compact)
+    {
+        display.quantize();
+    }
+
+    settled = true;
+    changes++;
+}
+
+bool BackgroundLoader::load(Object &obj, const std::filesystem::path &obj_filename)
+{
+    LoadCallback on_commit;
+    if (opts.progressive)
+    {
+        on_commit = [this](const Object &o, const float p) { return commit(o, p); };
+    }
+
+    if (!obj.load(obj_filename.string(), opts.color_support, opts.threads, on_commit, opts.file_normals))
+    {
+        return false;
+    }
+
+    // normalize to unit cube
+    obj.normalize();
+
+    if (opts.use_cache && !ObjectCache::save(obj, obj_filename, opts.color_support, opts.file_normals))
+    {
+        std::cerr << "warning: can't write model cache" << std::endl;
+    }
+
+    return true;
+}
+
+bool BackgroundLoader::commit(const Object &obj, const float progress)
+{
+    std::lock_guard lock(mutex);
+
+    const Vec3 signs = opts.orientation.signs();
+    auto transform = [this, &signs](const Vec3 &v) {
+        const Vec3 n = (v - center) * (1.0f / extent);
+        return Vec3(n.x * signs.x, n.y * signs.y, n.z * signs.z);
+    };
+
+    const bool grown = obj.vertices.size() > raw_count || obj.faces.size() > display.faces.size() || obj.materials.size() != display.materials.size();
+
+    // new vertices, normalization is redone only when bounds grew noticeably
+    if (obj.vertices.size() > raw_count)
+    {
+        if (raw_count == 0)
+        {
+            raw_min = raw_max = obj.vertices[0];
+        }
+
+        for (size_t i = raw_count; i < obj.vertices.size(); i++)
+        {
+            const Vec3 &v = obj.vertices[i];
+            raw_min = Vec3(std::min(raw_min.x, v.x), std::min(raw_min.y, v.y), std::min(raw_min.z, v.z));
+            raw_max = Vec3(std::max(raw_max.x, v.x), std::max(raw_max.y, v.y), std::max(raw_max.z, v.z));
+        }
+
+        size_t first = raw_count;
+        if (raw_count == 0 || max_extent(raw_min, raw_max) > extent * 1.25f)
+        {
+            center = (raw_min + raw_max) * 0.5f;
+            extent = max_extent(raw_min, raw_max);
+            first = 0;
+        }
+
+        display.vertices.resize(obj.vertices.size());
+        for (size_t i = first; i < obj.vertices.size(); i++)
+        {
+            display.vertices[i] = transform(obj.vertices[i]);
+        }
+
+        raw_count = obj.vertices.size();
+    }
+
+    // new faces
+    const bool flip = opts.orientation.flips_winding();
+    for (size_t i = display.faces.size(); i < obj.faces.size(); i++)
+    {
+        Face f = obj.faces[i];
+        if (flip)
+        {
+            std::swap(f.indices[1], f.indices[2]);
+        }
+        display.faces.push_back(f);
+    }
+
+    if (display.materials.size() != obj.materials.size())
+    {
+        display.materials = obj.materials;
+    }
+
+    // stalled input commits nothing new, only progress and cancelling are checked
+    if (grown)
+    {
+        changes++;
+    }
+
+    fraction = progress;
+    return !cancel;
+}
+
+void BackgroundLoader::publish(Object &&obj)
+{
+    // welding works in normalized units, cache keeps unwelded object
+    if (opts.weld)
+    {
+        welded = obj.weld(*opts.weld);
+    }
+
+    opts.orientation.apply(obj);
+
+    std::lock_guard lock(mutex);
+    display = std::move(obj);
+    fraction = 1.0f;
+    finished = true;
+    changes++;
+}
@@ -0,0 +1,95 @@
+/*
+ * loader.h
+ */
+
+#pragma once
+
+#include <atomic>
+#include <filesystem>
+#include <mutex>
+#include <thread>
+
+#include "object.h"
+
+// geometry fixes applied to loaded object after normalization
+class Orientation {
+public:
+    bool flip_faces = false;
+    bool invert_x = false;
+    bool invert_y = false;
+    bool invert_z = false;
+
+    void apply(Object &obj) const;
+
+    [[nodiscard]] bool flips_winding() const;   // odd number of winding flips in total
+    [[nodiscard]] Vec3 signs() const;           // per axis sign of vertices
+};
+
+// how object is loaded and prepared
+class LoadOptions {
+public:
+    bool color_support = false;     // load mtl materials
+    unsigned int threads = 0;       // parser threads, 0 - all cores
+    bool use_cache = true;          // read and write binary cache
+    bool rebuild_cache = false;     // ignore existing cache
+    std::optional<float> weld;      // vertex welding epsilon, none - no welding
+    bool compact = false;           // 16-bit quantized vertices
+    bool file_normals = false;      // shade with vn records of file
+    bool levels = true;             // coarser meshes for zooming out
+    bool pack = true;               // packed faces, pay off only over many frames
+    bool progressive = true;        // partial object is shown while loading, only viewer needs it
+    Orientation orientation;
+};
+
+// loads object on background thread, publishing committed parts for display
+class BackgroundLoader {
+public:
+    std::mutex mutex;   // guards object()
+
+    BackgroundLoader() = default;
+    ~BackgroundLoader();
+
+    BackgroundLoader(const BackgroundLoader &) = delete;
+    BackgroundLoader &operator=(const BackgroundLoader &) = delete;
+
+    void start(const std::filesystem::path &obj_filename, const LoadOptions &options);
+    void stop();    // cancel loading and wait for thread
+    void wait();    // wait until object is final
+
+    // partially loaded and provisionally normalized object until loading is finished, then final one
+    [[nodiscard]] const Object &object() const { return display; }
+
+    [[nodiscard]] bool loading() const { return !finished; }
+    [[nodiscard]] bool failed() const { return error; }
+    [[nodiscard]] float progress() const { return fraction; }
+
+    [[nodiscard]] bool working() const { return !settled; }             // object may still change
+    [[nodiscard]] unsigned int revision() const { return changes; }     // counts changes of object
+
+    // valid once loading is finished
+    [[nodiscard]] const std::optional<WeldStats> &weld_stats() const { return welded; }
+
+private:
+    void run(std::filesystem::path obj_filename);
+    bool load(Object &obj, const std::filesystem::path &obj_filename);  // parse, normalize and cache
+    bool commit(const Object &obj, float progress);
+    void publish(Object &&obj);
+
+    std::thread worker;
+    Object display;
+    LoadOptions opts;
+    std::optional<WeldStats> welded;
+
+    std::atomic<bool> finished = true;
+    std::atomic<bool> settled = true;
+    std::atomic<unsigned int> changes = 0;
+    std::atomic<bool> error = false;
+    std::atomic<bool> cancel = false;
+    std::atomic<float> fraction = 0.0f;
+
+    // provisional normalization of committed vertices
+    size_t raw_count = 0;       // committed vertices seen
+    Vec3 raw_min, raw_max;      // bounds of committed vertices
+    Vec3 center;                // used normalization
+    float extent = 0.0f;
+};
@@ -0,0 +1,333 @@
+/*
+ * lod.cpp
+ */
+
+#include "lod.h"
+
+#include <cstdint>
+#include <limits>
+#include <queue>
+
+#include "config.h"
+
+// helper classes
+
+// sum of squared distances to set of planes, symmetric 4x4 matrix
+class Quadric {
+public:
+    double a2 = 0, ab = 0, ac = 0, ad = 0, b2 = 0, bc = 0, bd = 0, c2 = 0, cd = 0, d2 = 0;
+
+    // plane n.p + d = 0 with unit n
+    static Quadric plane(const Vec3 &n, const double d, const double weight)
+    {
+        Quadric q;
+        q.a2 = weight * n.x * n.x; q.ab = weight * n.x * n.y; q.ac = weight * n.x * n.z; q.ad = weight * n.x * d;
+        q.b2 = weight * n.y * n.y; q.bc = weight * n.y * n.z; q.bd = weight * n.y * d;
+        q.c2 = weight * n.z * n.z; q.cd = weight * n.z * d;
+        q.d2 = weight * d * d;
+        return q;
+    }
+
+    Quadric &operator+=(const Quadric &o)
+    {
+        a2 += o.a2; ab += o.ab; ac += o.ac; ad += o.ad;
+        b2 += o.b2; bc += o.bc; bd += o.bd;
+        c2 += o.c2; cd += o.cd;
+        d2 += o.d2;
+        return *this;
+    }
+
+    [[nodiscard]] double error(const Vec3 &v) const
+    {
+        const double x = v.x, y = v.y, z = v.z;
+        const double e = a2 * x * x + 2 * ab * x * y + 2 * ac * x * z + 2 * ad * x
+                       + b2 * y * y + 2 * bc * y * z + 2 * bd * y
+                       + c2 * z * z + 2 * cd * z
+                       + d2;
+        return std::max(e, 0.0);
+    }
+};
+
+// candidate edge collapse, b merges into a
+class Collapse {
+public:
+    double cost;
+    uint32_t a, b;
+    uint32_t stamp_a, stamp_b;  // vertex versions when computed, stale otherwise
+    Vec3 target;
+
+    bool operator>(const Collapse &o) const { return cost > o.cost; }
+};
+
+// working state of decimation
+class Decimator {
+public:
+    explicit Decimator(const Object &obj) : positions(obj.vertices), faces(obj.faces), shading_normals(obj.shading_normals), quadrics(obj.vertices.size()),
+        vertex_faces(obj.vertices.size()), stamps(obj.vertices.size(), 0), removed(obj.vertices.size(), 0), alive(obj.faces.size(), 1), active(obj.faces.size())
+    {
+        // face planes
+        for (uint32_t f = 0; f < faces.size(); f++)
+        {
+            const auto &idx = faces[f].indices;
+            const Vec3 n = face_normal(positions[idx[0]], positions[idx[1]], positions[idx[2]]);
+            const Quadric q = Quadric::plane(n, -Vec3::dot(n, positions[idx[0]]), 1.0);
+
+            for (const auto v : idx)
+            {
+                quadrics[v] += q;
+                vertex_faces[v].push_back(f);
+            }
+        }
+
+        // open edges are held in place by perpendicular planes
+        std::vector<std::array<uint32_t, 3>> edges;    // a, b, face
+        edges.reserve(faces.size() * 3);
+        for (uint32_t f = 0; f < faces.size(); f++)
+        {
+            const auto &idx = faces[f].indices;
+            for (int k = 0; k < 3; k++)
+            {
+                edges.push_back({std::min(idx[k], idx[(k + 1) % 3]), std::max(idx[k], idx[(k + 1) % 3]), f});
+            }
+        }
+        std::ranges::sort(edges);
+
+        for (size_t i = 0; i < edges.size(); )
+        {
+            size_t j = i;
+            while (j < edges.size() && edges[j][0] == edges[i][0] && edges[j][1] == edges[i][1])
+                j++;
+
+            const uint32_t a = edges[i][0];
+            const uint32_t b = edges[i][1];
+
+            if (j - i == 1)
+            {
+                const auto &idx = faces[edges[i][2]].indices;
+                const Vec3 fn = face_normal(positions[idx[0]], positions[idx[1]], positions[idx[2]]);
+                const Vec3 n = Vec3::cross(positions[b] - positions[a], fn).normalize();
+                const Quadric q = Quadric::plane(n, -Vec3::dot(n, positions[a]), BOUNDARY_WEIGHT);
+                quadrics[a] += q;
+                quadrics[b] += q;
+            }
+
+            push(a, b);
+            i = j;
+        }
+    }
+
+    // collapse until at most target faces remain, false if nothing more can be collapsed
+    bool reduce(const size_t target, const std::atomic<bool> *cancel)
+    {
+        for (size_t step = 0; active > target; step++)
+        {
+            if (heap.empty() || (cancel && step % 4096 == 0 && *cancel))
+                return false;
+
+            const Collapse c = heap.top();
+            heap.pop();
+
+            if (removed[c.a] || removed[c.b] || stamps[c.a] != c.stamp_a || stamps[c.b] != c.stamp_b)
+                continue;   // stale
+
+            if (flips(c.a, c.b, c.target) || flips(c.b, c.a, c.target))
+                continue;
+
+            apply(c);
+        }
+
+        return true;
+    }
+
+    // current mesh as compact level
+    [[nodiscard]] MeshLevel snapshot() const
+    {
+        MeshLevel level;
+        level.error = static_cast<float>(std::sqrt(max_cost));
+
+        std::vector<uint32_t> remap(positions.size(), std::numeric_limits<uint32_t>::max());
+        level.faces.reserve(active);
+
+        for (size_t f = 0; f < faces.size(); f++)
+        {
+            if (!alive[f])
+                continue;
+
+            Face face = faces[f];
+            for (auto &idx : face.indices)
+            {
+                if (remap[idx] == std::numeric_limits<uint32_t>::max())
+                {
+                    remap[idx] = static_cast<uint32_t>(level.vertices.size());
+                    level.vertices.push_back(positions[idx]);
+                }
+                idx = remap[idx];
+            }
+            level.faces.push_back(face);
+
+            // collapses move corners of surviving faces only slightly, their file normals still hold
+            if (!shading_normals.empty())
+            {
+                level.shading_normals.push_back(shading_normals[f]);
+            }
+        }
+
+        return level;
+    }
+
+    [[nodiscard]] size_t active_faces() const { return active; }
+
+private:
+    static constexpr double BOUNDARY_WEIGHT = 10.0;
+
+    std::vector<Vec3> positions;
+    std::vector<Face> faces;
+    const std::vector<Vec3> &shading_normals;   // per original face, faces keep their index
+    std::vector<Quadric> quadrics;
+    std::vector<std::vector<uint32_t>> vertex_faces;    // may hold dead faces
+    std::vector<uint32_t> stamps;
+    std::vector<char> removed;
+    std::vector<char> alive;
+    size_t active;
+    double max_cost = 0.0;
+
+    std::priority_queue<Collapse, std::vector<Collapse>, std::greater<>> heap;
+
+    static Vec3 face_normal(const Vec3 &p1, const Vec3 &p2, const Vec3 &p3)
+    {
+        return Vec3::cross(p2 - p1, p3 - p1).normalize();
+    }
+
+    // cheapest of endpoints and midpoint
+    void push(const uint32_t a, const uint32_t b)
+    {
+        Quadric q = quadrics[a];
+        q += quadrics[b];
+
+        Collapse best {std::numeric_limits<double>::max(), a, b, stamps[a], stamps[b], positions[a]};
+        for (const Vec3 &p : {positions[a], positions[b], (positions[a] + positions[b]) * 0.5f})
+        {
+            if (const double e = q.error(p); e < best.cost)
+            {
+                best.cost = e;
+                best.target = p;
+            }
+        }
+
+        heap.push(best);
+    }
+
+    // moving v to target turns over some face not shared with other
+    [[nodiscard]] bool flips(const uint32_t v, const uint32_t other, const Vec3 &target) const
+    {
+        for (const auto f : vertex_faces[v])
+        {
+            if (!alive[f])
+                continue;
+
+            const auto &idx = faces[f].indices;
+            if (idx[0] == other || idx[1] == other || idx[2] == other)
+                continue;   // disappears with collapse
+
+            std::array<Vec3, 3> p = {positions[idx[0]], positions[idx[1]], positions[idx[2]]};
+            const Vec3 before = Vec3::cross(p[1] - p[0], p[2] - p[0]);
+
+            for (int k = 0; k < 3; k++)
+            {
+                if (idx[k] == v)
+                    p[k] = target;
+            }
+
+            const Vec3 after = Vec3::cross(p[1] - p[0], p[2] - p[0]);
+            if (Vec3::dot(before, after) <= 0.0f)
+                return true;
+        }
+
+        return false;
+    }
+
+    void apply(const Collapse &c)
+    {
+        const uint32_t a = c.a;
+        const uint32_t b = c.b;
+
+        positions[a] = c.target;
+        quadrics[a] += quadrics[b];
+        removed[b] = 1;
+        stamps[a]++;
+        stamps[b]++;
+        max_cost = std::max(max_cost, c.cost);
+
+        for (const auto f : vertex_faces[b])
+        {
+            if (!alive[f])
+                continue;
+
+            auto &idx = faces[f].indices;
+            if (idx[0] == a || idx[1] == a || idx[2] == a)
+            {
+                alive[f] = 0;   // edge face collapses
+                active--;
+                continue;
+            }
+
+            std::ranges::replace(idx, b, a);
+            vertex_faces[a].push_back(f);
+        }
+        vertex_faces[b] = {};
+
+        std::erase_if(vertex_faces[a], [this](const uint32_t f) { return !alive[f]; });
+
+        // new costs for edges around merged vertex
+        std::vector<uint32_t> neighbours;
+        for (const auto f : vertex_faces[a])
+        {
+            for (const auto v : faces[f].indices)
+            {
+                if (v != a)
+                    neighbours.push_back(v);
+            }
+        }
+        std::ranges::sort(neighbours);
+        const auto [first, last] = std::ranges::unique(neighbours);
+        neighbours.erase(first, last);
+
+        for (const auto v : neighbours)
+        {
+            push(a, v);
+        }
+    }
+};
+
+// main functions
+
+std::vector<MeshLevel> build_levels(const Object &obj, const std::atomic<bool> *cancel)
+{
+    std::vector<MeshLevel> levels;
+
+    if (obj.faces.size() < 2 * LOD_MIN_FACES)
+    {
+        return levels;
+    }
+
+    Decimator decimator(obj);
+
+    for (size_t target = obj.faces.size() / 2; target >= LOD_MIN_FACES && levels.size() < LOD_MAX_LEVELS; target = decimator.active_faces() / 2)
+    {
+        const bool reached = decimator.reduce(target, cancel);
+        if (cancel && *cancel)
+            return {};
+
+        // not worth a level if collapses stalled early
+        const size_t previous = levels.empty() ? obj.faces.size() : levels.back().faces.size();
+        if (decimator.active_faces() > previous * 3 / 4)
+            break;
+
+        levels.push_back(decimator.snapshot());
+
+        if (!reached)
+            break;
+    }
+
+    return levels;
+}
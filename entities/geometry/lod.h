@@ -0,0 +1,13 @@
+/*
+ * lod.h
+ */
+
+#pragma once
+
+#include <atomic>
+#include <vector>
+
+#include "object.h"
+
+// chain of simplified meshes, each about half the faces of previous one, by quadric edge collapse
+std::vector<MeshLevel> build_levels(const Object &obj, const std::atomic<bool> *cancel = nullptr);
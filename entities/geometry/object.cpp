@@ -4,53 +4,111 @@
 
 #include "object.h"
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <limits>
+#include <mutex>
+#include <span>
+#include <thread>
+#include <unordered_map>
+
+#include "parser.h"
+#include "utils/input_stream.h"
+#include "utils/mapped_file.h"
+#include "config.h"
+
 // helper functions
 
-// safe from string to int
-static std::optional<int> safe_stoi(const std::string &token)
-{
-    try {
-        size_t pos = 0;
-        int v = std::stoi(token, &pos, 10);
-        if (pos != token.size())
-            return std::nullopt;
-        return v;
-    }
-    catch (const std::exception &) {
-        return std::nullopt;
+// bounded queue of text blocks between decoder and parser
+class BlockQueue {
+public:
+    explicit BlockQueue(const size_t capacity) : capacity(capacity) {}
+
+    // blocks while full, false once closed
+    bool push(std::string &&block)
+    {
+        std::unique_lock lock(mutex);
+        not_full.wait(lock, [this]() { return closed || blocks.size() < capacity; });
+        if (closed)
+        {
+            return false;
+        }
+
+        blocks.push_back(std::move(block));
+        not_empty.notify_one();
+        return true;
     }
-}
 
-// from obj index to vector index
-static int relative_index(const int idx, int total_vertices)
-{
-    if (idx == 0 || idx < -total_vertices || idx > total_vertices)
+    enum class Pop { block, timeout, closed };
+
+    // blocks while empty up to timeout, closed once closed and drained
+    Pop pop(std::string &block, const std::chrono::milliseconds timeout)
     {
-        std::cerr << "warning: invalid vertex index " << idx << std::endl;
-        return -1;
+        std::unique_lock lock(mutex);
+        if (!not_empty.wait_for(lock, timeout, [this]() { return closed || !blocks.empty(); }))
+        {
+            return Pop::timeout;
+        }
+
+        if (blocks.empty())
+        {
+            return Pop::closed;
+        }
+
+        block = std::move(blocks.front());
+        blocks.pop_front();
+        not_full.notify_one();
+        return Pop::block;
     }
 
-    return idx < 0 ? total_vertices + idx : idx - 1;
-}
+    void close()
+    {
+        std::lock_guard lock(mutex);
+        closed = true;
+        not_full.notify_all();
+        not_empty.notify_all();
+    }
 
-// clean string
-static void strip_line(std::string &line)
+private:
+    std::mutex mutex;
+    std::condition_variable not_full;
+    std::condition_variable not_empty;
+    std::deque<std::string> blocks;
+    size_t capacity;
+    bool closed = false;
+};
+
+// quantized positions replace packed or plain ones of object or level
+template<typename Mesh>
+static void quantize_mesh(Mesh &mesh)
 {
-    std::erase_if(line, [](const char c) { return c == '\r' || c == '\n'; });
-    std::ranges::replace(line, '\t', ' ');
+    if (mesh.packed)
+    {
+        mesh.compact.emplace(mesh.packed->positions);
+        mesh.packed->positions = {};
+    }
+    else
+    {
+        mesh.compact.emplace(mesh.vertices);
+        mesh.vertices = {};
+    }
 }
 
 // check open file
-static std::optional<std::ifstream> open_file(const std::string &filename)
+static bool open_file(MappedFile &file, const std::string &filename)
 {
-    std::ifstream in(filename, std::ios::in | std::ios::binary);
-    if (!in.is_open())
+    if (!file.open(filename))
     {
         std::cerr << "error: can't open file " << filename << std::endl;
-        return std::nullopt;
+        return false;
     }
 
-    return in;
+    return true;
 }
 
 // parse functions
@@ -79,100 +137,10 @@ bool Object::validate() const
     return true;
 }
 
-// parse v x y z
-bool Object::parse_vertex(const std::string &line)
-{
-    std::stringstream ss(line);
-
-    float x, y, z;
-    if (!(ss >> x >> y >> z))
-    {
-        std::cerr << "warning: invalid vertex format" << std::endl;
-        return false;
-    }
-
-    vertices.emplace_back(x, y, z);
-    return true;
-}
-
-// parse f
-bool Object::parse_face(const std::string &line, std::optional<int> current_material)
-{
-    std::stringstream ss(line);
-    std::vector<unsigned int> local_indices;
-
-    std::string token;
-    while (ss >> token)
-    {
-        if (const auto slash_pos = token.find('/'); slash_pos != std::string::npos)
-        {
-            token.erase(slash_pos); // keep only first index
-        }
-
-        auto maybe_idx = safe_stoi(token);
-        if (!maybe_idx)
-        {
-            std::cerr << "warning: invalid face token " << token << std::endl;
-            return false;
-        }
-
-        int ridx = relative_index(*maybe_idx, static_cast<int>(vertices.size()));
-        if (ridx < 0 || static_cast<size_t>(ridx) >= vertices.size())
-        {
-            std::cerr << "warning: vertex index " << *maybe_idx << " out of range" << std::endl;
-            return false;
-        }
-        local_indices.push_back(static_cast<unsigned int>(ridx));
-    }
-
-    if (local_indices.size() < 3)
-    {
-        std::cerr << "warning: face contains less than 3 indexes" << std::endl;
-        return false;
-    }
-
-    if (local_indices.size() == 3)
-    {
-        faces.emplace_back(local_indices[0], local_indices[1], local_indices[2], current_material);
-        return true;
-    }
-
-    // triangularization
-    std::vector<Vec3> polygon;
-    polygon.reserve(local_indices.size());
-
-    for (const auto idx : local_indices)
-    {
-        polygon.push_back(vertices[idx]);
-    }
-
-    const auto result = triangularize(polygon);
-    if (!result.has_value())
-    {
-        std::cerr << "warning: triangularize failed" << std::endl;
-        return false;
-    }
-
-    // adding faces
-    const auto &triangle_indices = result.value();
-    for (size_t i = 0; i < triangle_indices.size(); i += 3)
-    {
-        unsigned int i1 = local_indices[ triangle_indices[i] ];
-        unsigned int i2 = local_indices[ triangle_indices[i+1] ];
-        unsigned int i3 = local_indices[ triangle_indices[i+2] ];
-        faces.emplace_back(i1, i2, i3, current_material);
-    }
-
-    return true;
-}
-
 // parse mtllib
-bool Object::parse_mtl_file(const std::string &line, const std::string &obj_filename)
+bool Object::parse_mtl_file(std::string_view line, const std::string &obj_filename)
 {
-    std::stringstream ss(line);
-
-    std::string mtl_filename;
-    ss >> mtl_filename;
+    const std::string_view mtl_filename = next_token(line);
     if (mtl_filename.empty())
     {
         std::cerr << "error: can't parse mtl filename" << std::endl;
@@ -186,41 +154,37 @@ bool Object::parse_mtl_file(const std::string &line, const std::string &obj_file
 }
 
 // parse usemtl
-std::optional<int> Object::parse_material(const std::string &line) const
+std::optional<int> Object::parse_material(std::string_view line) const
 {
-    std::stringstream ss(line);
-
-    std::string material_name;
-    ss >> material_name;
-
-    return find_material(material_name);
+    return find_material(std::string(next_token(line)));
 }
 
 // parse newmtl
-bool Object::parse_current_material(const std::string &line, std::string &current_name, Vec3 &current_diffuse, bool &have_active_material)
+bool Object::parse_current_material(std::string_view line, std::string &current_name, Vec3 &current_diffuse, bool &have_active_material)
 {
     if (have_active_material)
     {
         materials.emplace_back(current_name, current_diffuse);
     }
 
-    if (std::stringstream ss(line); !(ss >> current_name))
+    const std::string_view name = next_token(line);
+    if (name.empty())
     {
         std::cerr << "error: can't parse material name" << std::endl;
         return false;
-    };
+    }
+
+    current_name = name;
     current_diffuse = Vec3(1.0f, 1.0f, 1.0f);
     have_active_material = true;
     return true;
 }
 
 // parse kd
-bool Object::parse_diffuse_color(const std::string &line, Vec3 &current_diffuse)
+bool Object::parse_diffuse_color(std::string_view line, Vec3 &current_diffuse)
 {
-    std::stringstream ss(line);
-
     float r, g, b;
-    if (!(ss >> r >> g >> b))
+    if (!parse_float(next_token(line), r) || !parse_float(next_token(line), g) || !parse_float(next_token(line), b))
     {
         std::cerr << "error: can't parse diffuse colors" << std::endl;
         return false;
@@ -231,105 +195,288 @@ bool Object::parse_diffuse_color(const std::string &line, Vec3 &current_diffuse)
 }
 
 // methods
-bool Object::load(const std::string &obj_filename, bool color_support)
+bool Object::load(const std::string &obj_filename, bool color_support, unsigned int threads, const LoadCallback &on_commit, bool file_normals)
 {
-    auto file = open_file(obj_filename);
-    if (!file)
+    MappedFile file;
+    if (obj_filename != "-" && !open_file(file, obj_filename))
     {
         return false;
     }
 
-    std::ifstream in = std::move(*file);
+    // compressed data can't be split, parsed while it is decoded
+    if (obj_filename == "-" || InputStream::detect(file.view().substr(0, 4)) != InputStream::Format::plain)
+    {
+        file.close();
+
+        InputStream input;
+        if (!input.open(obj_filename))
+        {
+            std::cerr << "error: " << (input.failed() ? obj_filename + ": " + input.error() : "can't open file " + obj_filename) << std::endl;
+            return false;
+        }
 
+        return load_stream(input, obj_filename, color_support, file_normals, on_commit);
+    }
+
+    if (threads == 0)
+    {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    const std::string_view text = file.view();
+    std::vector<ObjChunk> chunks = split_chunks(text, std::max<size_t>(text.size() / LOAD_CHUNK_SIZE, 1));
+
+    // chunks are committed in file order, everything after first fatal line is dropped
     std::optional<int> current_material = std::nullopt;
-    std::string line;
+    std::vector<Vec3> all_normals;
+    bool stopped = false;
+    size_t done_bytes = 0;
+    std::atomic<bool> cancelled = false;
+
+    auto notify = [&](const ObjChunk &chunk) {
+        done_bytes += chunk.text.size();
+        if (on_commit && !on_commit(*this, static_cast<float>(done_bytes) / static_cast<float>(2 * text.size())))
+        {
+            cancelled = true;
+        }
+    };
+
+    // estimated from first chunk, avoids regrowth on large files
+    auto reserve = [&text](auto &v, size_t count, const ObjChunk &chunk) {
+        if (&chunk.text.front() == &text.front())
+            v.reserve(v.size() + count * (text.size() / chunk.text.size() + 1));
+    };
 
-    while (std::getline(in, line))
+    // chunks go through both passes in waves, so faces of every wave are shown before next one is scanned,
+    // faces only refer back, without anyone to show them whole file is one wave
+    const size_t wave = on_commit ? threads * LOAD_WAVE_CHUNKS : chunks.size();
+    bool faces_stopped = false;
+
+    for (size_t first = 0; first < chunks.size() && !stopped; first += wave)
     {
-        strip_line(line);
+        const std::span<ObjChunk> part(chunks.data() + first, std::min(wave, chunks.size() - first));
+
+        // first pass - vertices, material state and vertex count before every chunk
+        for_each_chunk(part, threads, [&cancelled, color_support, file_normals](ObjChunk &chunk) { if (!cancelled) chunk.scan(color_support, file_normals); }, [&](ObjChunk &chunk) {
+            if (stopped || cancelled)
+            {
+                chunk.limit = chunk.offset;
+                return;
+            }
 
-        if (line.empty() || line[0] == '#') // comment
+            reserve(vertices, chunk.vertices.size(), chunk);
+            commit_vertices(chunk, current_material, all_normals, obj_filename);
+
+            stopped = chunk.limit != std::string_view::npos;
+            notify(chunk);
+        });
+
+        if (cancelled)
+        {
+            return false;
+        }
+
+        // second pass - faces against vertices committed so far, vertices of file after first fatal face are still kept
+        if (faces_stopped)
         {
             continue;
         }
 
-        std::stringstream ss(line);
-        std::string cmd;
-        ss >> cmd;
+        for_each_chunk(part, threads, [this, &cancelled, &all_normals, color_support](ObjChunk &chunk) { if (!cancelled) chunk.parse_faces(vertices, all_normals, color_support); }, [&](ObjChunk &chunk) {
+            if (faces_stopped || cancelled)
+            {
+                return;
+            }
+
+            reserve(faces, chunk.faces.size(), chunk);
+            commit_faces(chunk);
+
+            faces_stopped = chunk.limit != std::string_view::npos;
+            notify(chunk);
+        });
+    }
+
+    if (cancelled || !flush_diagnostics(chunks))
+    {
+        return false;
+    }
 
-        std::string arguments = line.substr(cmd.size());
-        if (!arguments.empty() && arguments[0] == ' ')
+    return validate();
+}
+
+bool Object::load_stream(InputStream &input, const std::string &obj_filename, bool color_support, bool file_normals, const LoadCallback &on_commit)
+{
+    BlockQueue queue(LOAD_QUEUE_BLOCKS);
+
+    // decoder thread - line aligned blocks, partial last line is carried over
+    std::thread decoder([&input, &queue]() {
+        std::string carry;
+        std::vector<char> buffer(LOAD_CHUNK_SIZE);
+
+        for (size_t n = input.read(buffer.data(), buffer.size()); n > 0; n = input.read(buffer.data(), buffer.size()))
         {
-            arguments.erase(0, 1);
+            std::string block = std::move(carry);
+            block.append(buffer.data(), n);
+
+            const size_t nl = block.rfind('\n');
+            if (nl == std::string::npos)
+            {
+                carry = std::move(block);
+                continue;
+            }
+
+            carry.assign(block, nl + 1);
+            block.resize(nl + 1);
+
+            if (!queue.push(std::move(block)))
+            {
+                return;     // parser stopped
+            }
+        }
+
+        if (!carry.empty())
+        {
+            queue.push(std::move(carry));
         }
+        queue.close();
+    });
 
-        bool ok = true;
+    // every block goes through both passes before next one, faces only refer back
+    std::optional<int> current_material = std::nullopt;
+    std::vector<Vec3> all_normals;
+    size_t offset = 0;
+    bool ok = true;
+    std::string block;
 
-        if (cmd == "v") // vertex
+    while (ok)
+    {
+        const BlockQueue::Pop popped = queue.pop(block, std::chrono::milliseconds(LOAD_POLL_MS));
+        if (popped == BlockQueue::Pop::closed)
         {
-            ok = parse_vertex(arguments);
+            break;
         }
-        else if (cmd == "f") // face
+
+        // input stalls, loading may still be cancelled meanwhile
+        if (popped == BlockQueue::Pop::timeout)
         {
-            ok = parse_face(arguments, current_material);
+            ok = !on_commit || on_commit(*this, input.progress());
+            continue;
         }
-        else if (color_support && cmd == "mtllib")  // material file
+
+        std::vector<ObjChunk> chunks;
+        ObjChunk &chunk = chunks.emplace_back(block, offset);
+        offset += block.size();
+
+        chunk.scan(color_support, file_normals);
+        commit_vertices(chunk, current_material, all_normals, obj_filename);
+        chunk.parse_faces(vertices, all_normals, color_support);
+        commit_faces(chunk);
+
+        ok = flush_diagnostics(chunks) && chunk.limit == std::string_view::npos;
+        if (ok && on_commit && !on_commit(*this, input.progress()))
         {
-            ok = parse_mtl_file(arguments, obj_filename);
+            ok = false;
         }
-        else if (color_support && cmd == "usemtl")  // material
+    }
+
+    // decoder may wait on input that never comes
+    input.interrupt();
+    queue.close();
+    decoder.join();
+
+    if (!ok)
+    {
+        return false;
+    }
+
+    if (input.failed())
+    {
+        std::cerr << "error: " << obj_filename << ": " << input.error() << std::endl;
+        return false;
+    }
+
+    return validate();
+}
+
+// first pass - material lines in file order, then vertices
+void Object::commit_vertices(ObjChunk &chunk, std::optional<int> &current_material, std::vector<Vec3> &all_normals, const std::string &obj_filename)
+{
+    chunk.vertex_base = vertices.size();
+    chunk.normal_base = all_normals.size();
+    chunk.start_material = current_material;
+
+    for (auto &event : chunk.events)
+    {
+        if (event.offset >= chunk.limit)
         {
-            current_material = parse_material(arguments);
+            break;
+        }
 
-            if (!current_material)
+        if (event.library)  // material file
+        {
+            if (!parse_mtl_file(event.arguments, obj_filename))
             {
-                std::cerr << "warning: unknown material " << arguments << std::endl;
+                chunk.report(event.offset, "", true);
+                break;
             }
         }
-        // ignoring anything else
-
-        if (!ok)
+        else                // material
         {
-            return false;
+            current_material = parse_material(event.arguments);
+            event.material = current_material;
+
+            if (!current_material)
+            {
+                chunk.report(event.offset, "warning: unknown material " + std::string(trim(event.arguments)), false);
+            }
         }
     }
 
-    in.close();
-    return validate();
+    vertices.insert(vertices.end(), chunk.vertices.begin(), chunk.vertices.end());
+    chunk.vertices = {};
+
+    all_normals.insert(all_normals.end(), chunk.normals.begin(), chunk.normals.end());
+    chunk.normals = {};
+}
+
+// second pass - faces
+void Object::commit_faces(ObjChunk &chunk)
+{
+    // faces streamed before first vn record have none
+    if (!chunk.face_normals.empty() || !shading_normals.empty())
+    {
+        shading_normals.resize(faces.size());
+        shading_normals.insert(shading_normals.end(), chunk.face_normals.begin(), chunk.face_normals.end());
+        shading_normals.resize(faces.size() + chunk.faces.size());
+    }
+
+    faces.insert(faces.end(), chunk.faces.begin(), chunk.faces.end());
+    chunk.faces = {};
+    chunk.face_normals = {};
 }
 
 bool Object::load_materials(const std::string &mtl_filename)
 {
-    auto file = open_file(mtl_filename);
-    if (!file.has_value())
+    MappedFile file;
+    if (!open_file(file, mtl_filename))
     {
         return false;
     }
 
-    std::ifstream in = std::move(*file);
+    std::string_view text = file.view();
 
     std::string current_name;
     Vec3 current_diffuse(1.0f, 1.0f, 1.0f);
     bool have_active_material = false;
-    std::string line;
 
-    while (std::getline(in, line))
+    while (!text.empty())
     {
-        strip_line(line);
+        std::string_view arguments = next_line(text);
+        const std::string_view cmd = next_token(arguments);
 
-        if (line.empty() || line[0] == '#') // comment
+        if (cmd.empty() || cmd[0] == '#') // comment
             continue;
 
-        std::stringstream ss(line);
-        std::string cmd;
-        ss >> cmd;
-
-        std::string arguments = line.substr(cmd.size());
-        if (!arguments.empty() && arguments[0] == ' ')
-        {
-            arguments.erase(0, 1);
-        }
-
         if (cmd == "newmtl") // current material
         {
             parse_current_material(arguments, current_name, current_diffuse, have_active_material);
@@ -391,6 +538,157 @@ void Object::normalize()
     }
 }
 
+void Object::quantize()
+{
+    quantize_mesh(*this);
+
+    for (auto &level : levels)
+    {
+        quantize_mesh(level);
+    }
+}
+
+void Object::pack()
+{
+    packed.emplace(vertices, faces, shading_normals);
+    vertices = {};
+    faces = {};
+    shading_normals = {};
+
+    for (auto &level : levels)
+    {
+        level.packed.emplace(level.vertices, level.faces, level.shading_normals);
+        level.vertices = {};
+        level.faces = {};
+        level.shading_normals = {};
+    }
+}
+
+WeldStats Object::weld(const float epsilon)
+{
+    WeldStats stats;
+    stats.vertices_before = vertices.size();
+
+    // spatial hash of kept vertices, cells of epsilon size chained through next
+    std::unordered_map<uint64_t, unsigned int> heads;
+    heads.reserve(vertices.size());
+    std::vector<unsigned int> next;
+    std::vector<Vec3> kept;
+    std::vector<unsigned int> remap(vertices.size());
+
+    constexpr auto none = std::numeric_limits<unsigned int>::max();
+    const int reach = epsilon > 0.0f ? 1 : 0;   // neighbour cells to search
+
+    // cells keep within int64 range with neighbours, cells larger than epsilon only add candidates to check
+    constexpr float limit = 0x1p62f;
+    float extent = 0.0f;
+    for (const Vec3 &v : vertices)
+    {
+        for (const float c : {v.x, v.y, v.z})
+        {
+            if (std::isfinite(c))
+            {
+                extent = std::max(extent, std::fabs(c));
+            }
+        }
+    }
+
+    const float inverse = epsilon > 0.0f ? std::min(1.0f / epsilon, limit / extent) : 0.0f;
+
+    auto cell = [inverse, limit](const float value) -> int64_t {
+        if (inverse == 0.0f)
+        {
+            uint32_t bits;
+            const float v = value == 0.0f ? 0.0f : value;   // -0 equals 0
+            std::memcpy(&bits, &v, sizeof(bits));
+            return bits;
+        }
+
+        // non-finite coordinates and rounding past limit end in border cells, casting them is undefined
+        const float scaled = std::floor(value * inverse);
+        return std::isnan(scaled) ? 0 : static_cast<int64_t>(std::clamp(scaled, -limit, limit));
+    };
+
+    auto key = [](const int64_t x, const int64_t y, const int64_t z) {
+        return static_cast<uint64_t>(x) * 0x9e3779b97f4a7c15ull ^ static_cast<uint64_t>(y) * 0xc2b2ae3d27d4eb4full ^ static_cast<uint64_t>(z) * 0x165667b19e3779f9ull;
+    };
+
+    for (size_t i = 0; i < vertices.size(); i++)
+    {
+        const Vec3 &v = vertices[i];
+        const int64_t cx = cell(v.x);
+        const int64_t cy = cell(v.y);
+        const int64_t cz = cell(v.z);
+
+        unsigned int match = none;
+        for (int dx = -reach; dx <= reach && match == none; dx++)
+        {
+            for (int dy = -reach; dy <= reach && match == none; dy++)
+            {
+                for (int dz = -reach; dz <= reach && match == none; dz++)
+                {
+                    const auto it = heads.find(key(cx + dx, cy + dy, cz + dz));
+                    for (unsigned int k = it == heads.end() ? none : it->second; k != none; k = next[k])
+                    {
+                        const Vec3 d = kept[k] - v;
+                        if (Vec3::dot(d, d) <= epsilon * epsilon)
+                        {
+                            match = k;
+                            break;
+                        }
+                    }
+                }
+            }
+        }
+
+        if (match == none)
+        {
+            match = static_cast<unsigned int>(kept.size());
+            kept.push_back(v);
+
+            auto [it, inserted] = heads.try_emplace(key(cx, cy, cz), match);
+            next.push_back(inserted ? none : it->second);
+            it->second = match;
+        }
+
+        remap[i] = match;
+    }
+
+    // remap faces, collapsed ones are removed along with their normals
+    size_t kept_faces = 0;
+    for (size_t i = 0; i < faces.size(); i++)
+    {
+        Face f = faces[i];
+        for (auto &idx : f.indices)
+        {
+            idx = remap[idx];
+        }
+
+        if (f.indices[0] == f.indices[1] || f.indices[1] == f.indices[2] || f.indices[2] == f.indices[0])
+        {
+            continue;
+        }
+
+        if (!shading_normals.empty())
+        {
+            shading_normals[kept_faces] = shading_normals[i];
+        }
+        faces[kept_faces++] = f;
+    }
+
+    stats.faces_removed = faces.size() - kept_faces;
+    faces.erase(faces.begin() + static_cast<std::ptrdiff_t>(kept_faces), faces.end());
+    if (!shading_normals.empty())
+    {
+        shading_normals.resize(kept_faces);
+    }
+
+    vertices = std::move(kept);
+    vertices.shrink_to_fit();
+    stats.vertices_after = vertices.size();
+    return stats;
+}
+
 void Object::flip_faces()
 {
     for (auto &f : faces)
@@ -406,6 +704,11 @@ void Object::invert_x()
         v.x = -v.x;
     }
 
+    for (auto &n : shading_normals)
+    {
+        n.x = -n.x;
+    }
+
     flip_faces();
 }
 
@@ -416,6 +719,11 @@ void Object::invert_y()
         v.y = -v.y;
     }
 
+    for (auto &n : shading_normals)
+    {
+        n.y = -n.y;
+    }
+
     flip_faces();
 }
 
@@ -427,5 +735,10 @@ void Object::invert_z()
         v.z = -v.z;
     }
 
+    for (auto &n : shading_normals)
+    {
+        n.z = -n.z;
+    }
+
     flip_faces();
 }
@@ -5,17 +5,19 @@
 #pragma once
 
 #include <array>
+#include <functional>
 #include <optional>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <filesystem>
-#include <fstream>
 #include <iostream>
-#include <sstream>
 #include <algorithm>
 #include <cctype>
 #include <cstring>
 
+#include "packed.h"
+#include "quantized.h"
 #include "utils/algorithms.h"
 
 // triangular face
@@ -27,6 +29,19 @@ public:
     Face(const unsigned int idx1, const unsigned int idx2, const unsigned int idx3, const std::optional<int> mat = std::nullopt) : indices{idx1, idx2, idx3}, material(mat) {}
 };
 
+// simplified copy of object mesh
+class MeshLevel {
+public:
+    std::vector<Vec3> vertices;
+    std::optional<QuantizedPositions> compact;  // replaces vertices in compact mode
+    std::vector<Face> faces;
+    std::vector<Vec3> shading_normals;          // of faces surviving from full mesh, empty unless loaded
+    std::optional<PackedMesh> packed;           // replaces vertices and faces once packed
+    float error = 0.0f;         // geometric deviation from full mesh, object units
+
+    [[nodiscard]] size_t face_count() const { return packed ? packed->face_count() : faces.size(); }
+};
+
 // material properties
 class Material {
 public:
@@ -36,20 +51,51 @@ public:
     Material(const std::string &name, const Vec3 &color) : material_name(name), diffuse(color) {}
 };
 
+// result of vertex welding
+class WeldStats {
+public:
+    size_t vertices_before = 0;
+    size_t vertices_after = 0;
+    size_t faces_removed = 0;   // degenerate after welding
+};
+
+class Object;
+class ObjChunk;
+class InputStream;
+
+// receives object during load each time a part of file is committed, progress in 0..1, false cancels loading
+using LoadCallback = std::function<bool(const Object &obj, float progress)>;
+
 // object (3d model)
 class Object {
 public:
     Object() = default;
 
     std::vector<Vec3> vertices;
+    std::optional<QuantizedPositions> compact;  // replaces vertices in compact mode
     std::vector<Face> faces;
+    std::vector<Vec3> shading_normals;          // per face averaged from vn records, zero where missing, empty unless loaded
+    std::optional<PackedMesh> packed;           // replaces vertices and faces once packed
     std::vector<Material> materials;
+    std::vector<MeshLevel> levels;  // progressively coarser meshes, empty until built
 
-    // load obj file with optional material mtl support
-    bool load(const std::string &obj_filename, bool color_support = false);
+    [[nodiscard]] size_t face_count() const { return packed ? packed->face_count() : faces.size(); }
+
+    // load obj file with optional material mtl support, parsed on threads workers (0 - all cores)
+    // gzip or zstd compressed files and standard input ("-") are streamed, file_normals reads vn records
+    bool load(const std::string &obj_filename, bool color_support = false, unsigned int threads = 1, const LoadCallback &on_commit = {}, bool file_normals = false);
 
 
     void normalize();   // normalize object
+
+    // store positions of mesh and its levels as 16-bit fixed point, vertices or packed positions are emptied
+    void quantize();
+
+    // lay out mesh and its levels for rendering with face normals, vertices and faces are emptied
+    void pack();
+
+    // merge vertices closer than epsilon (0 - identical only), remap faces and drop degenerate ones
+    WeldStats weld(float epsilon = 0.0f);
     void flip_faces();  // flip faces winding order
 
     void invert_x();    // invert axes
@@ -57,17 +103,22 @@ public:
     void invert_z();
 
 private:
+    // streamed load, decompression runs ahead of parsing on its own thread
+    bool load_stream(InputStream &input, const std::string &obj_filename, bool color_support, bool file_normals, const LoadCallback &on_commit);
+
+    // in order commits of parsed chunks, vn records are collected in all_normals
+    void commit_vertices(ObjChunk &chunk, std::optional<int> &current_material, std::vector<Vec3> &all_normals, const std::string &obj_filename);
+    void commit_faces(ObjChunk &chunk);
+
     // material related methods
     bool load_materials(const std::string &mtl_filename);
     std::optional<int> find_material(const std::string &material_name) const;
 
-    // composite methods of parser
-    bool parse_vertex(const std::string &line);
-    bool parse_face(const std::string &line, std::optional<int> current_material);
-    bool parse_mtl_file(const std::string &line, const std::string &obj_filename);
-    std::optional<int> parse_material(const std::string &line) const;
-    bool parse_current_material(const std::string &line, std::string &current_name, Vec3 &current_diffuse, bool &have_active_material);
-    static bool parse_diffuse_color(const std::string &line, Vec3 &current_diffuse);
+    // composite methods of parser, lines are views into mapped file
+    bool parse_mtl_file(std::string_view line, const std::string &obj_filename);
+    std::optional<int> parse_material(std::string_view line) const;
+    bool parse_current_material(std::string_view line, std::string &current_name, Vec3 &current_diffuse, bool &have_active_material);
+    static bool parse_diffuse_color(std::string_view line, Vec3 &current_diffuse);
 
     // validation of object after parsing
     bool validate() const;
@@ -0,0 +1,87 @@
+/*
+ * packed.cpp
+ */
+
+#include "packed.h"
+
+#include "object.h"
+
+PlanarPositions::PlanarPositions(const std::vector<Vec3> &positions)
+{
+    x.reserve(positions.size());
+    y.reserve(positions.size());
+    z.reserve(positions.size());
+
+    for (const auto &v : positions)
+    {
+        x.push_back(v.x);
+        y.push_back(v.y);
+        z.push_back(v.z);
+    }
+}
+
+PackedMesh::PackedMesh(const std::vector<Vec3> &vertices, const std::vector<Face> &faces, const std::vector<Vec3> &shading_normals) : positions(vertices)
+{
+    indices.reserve(faces.size() * 3);
+    normals.reserve(faces.size());
+
+    for (const auto &f : faces)
+    {
+        const int material = f.material ? *f.material : -1;
+        const auto first = static_cast<uint32_t>(indices.size() / 3);
+
+        if (runs.empty() || runs.back().material != material)
+        {
+            runs.push_back({first, 0, material});
+        }
+        runs.back().count++;
+
+        indices.insert(indices.end(), f.indices.begin(), f.indices.end());
+
+        const Vec3 &p1 = vertices[f.indices[0]];
+        normals.push_back(Vec3::cross(vertices[f.indices[1]] - p1, vertices[f.indices[2]] - p1).normalize());
+    }
+
+    // faces without vn keep their winding normal
+    if (!shading_normals.empty())
+    {
+        shading = normals;
+        for (size_t i = 0; i < shading.size() && i < shading_normals.size(); i++)
+        {
+            if (shading_normals[i].magnitude() > 0.0f)
+            {
+                shading[i] = shading_normals[i];
+            }
+        }
+    }
+
+    // per face data follows faces reordered by hierarchy
+    std::vector<uint32_t> order;
+    bvh = FaceBvh(vertices, indices, runs, order);
+
+    for (auto *data : {&normals, &shading})
+    {
+        if (data->empty())
+        {
+            continue;
+        }
+
+        std::vector<Vec3> reordered(data->size());
+        for (size_t i = 0; i < order.size(); i++)
+        {
+            reordered[i] = (*data)[order[i]];
+        }
+        *data = std::move(reordered);
+    }
+}
+
+float PackedMesh::bytes_per_face() const
+{
+    if (indices.empty())
+    {
+        return 0.0f;
+    }
+
+    const size_t bytes = indices.size() * sizeof(indices[0]) + runs.size() * sizeof(runs[0]) + (normals.size() + shading.size()) * sizeof(Vec3) + bvh.bytes();
+    return static_cast<float>(bytes) / static_cast<float>(face_count());
+}
@@ -0,0 +1,54 @@
+/*
+ * packed.h
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "bvh.h"
+#include "utils/mathematics.h"
+
+class Face;
+
+// vertex positions as separate coordinate arrays
+class PlanarPositions {
+public:
+    std::vector<float> x;
+    std::vector<float> y;
+    std::vector<float> z;
+
+    PlanarPositions() = default;
+    explicit PlanarPositions(const std::vector<Vec3> &positions);
+
+    [[nodiscard]] size_t size() const { return x.size(); }
+    [[nodiscard]] Vec3 operator[](const size_t i) const { return {x[i], y[i], z[i]}; }
+};
+
+// consecutive faces sharing material
+class MaterialRun {
+public:
+    uint32_t first;     // first face of run
+    uint32_t count;     // faces in run
+    int material;       // index of material, -1 for none
+};
+
+// mesh laid out for rendering, faces keep their material runs, within run they follow leaves of hierarchy
+class PackedMesh {
+public:
+    PlanarPositions positions;      // empty when quantized positions are used
+    std::vector<uint32_t> indices;  // three vertex indices per face
+    std::vector<MaterialRun> runs;  // cover all faces in order
+    std::vector<Vec3> normals;      // unit face normals in object space, from winding
+    std::vector<Vec3> shading;      // unit face normals for lighting from vn records, empty if file has none
+    FaceBvh bvh;                    // for culling faces outside of view
+
+    PackedMesh() = default;
+    PackedMesh(const std::vector<Vec3> &vertices, const std::vector<Face> &faces, const std::vector<Vec3> &shading_normals = {});
+
+    [[nodiscard]] size_t face_count() const { return indices.size() / 3; }
+
+    // memory of indices, material runs, normals and hierarchy per face
+    [[nodiscard]] float bytes_per_face() const;
+};
@@ -0,0 +1,404 @@
+/*
+ * parser.cpp
+ */
+
+#include "parser.h"
+
+#include <atomic>
+#include <charconv>
+#include <mutex>
+#include <thread>
+
+// helper functions
+
+// whitespace inside line
+static bool is_blank(const char c)
+{
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+// whole token to int, in place
+static std::optional<int> parse_int(std::string_view token)
+{
+    if (!token.empty() && token[0] == '+')
+        token.remove_prefix(1);
+
+    int value = 0;
+    const char *end = token.data() + token.size();
+    if (const auto [ptr, ec] = std::from_chars(token.data(), end, value); ec != std::errc() || ptr != end)
+        return std::nullopt;
+
+    return value;
+}
+
+// from obj index to vector index
+static int relative_index(const int idx, int total_vertices, ObjChunk &chunk, size_t line_offset)
+{
+    if (idx == 0 || idx < -total_vertices || idx > total_vertices)
+    {
+        chunk.report(line_offset, "warning: invalid vertex index " + std::to_string(idx), false);
+        return -1;
+    }
+
+    return idx < 0 ? total_vertices + idx : idx - 1;
+}
+
+// parse v x y z
+static bool parse_vertex(std::string_view line, ObjChunk &chunk, size_t line_offset)
+{
+    float x, y, z;
+    if (!parse_float(next_token(line), x) || !parse_float(next_token(line), y) || !parse_float(next_token(line), z))
+    {
+        chunk.report(line_offset, "warning: invalid vertex format", true);
+        return false;
+    }
+
+    chunk.vertices.emplace_back(x, y, z);
+    return true;
+}
+
+// parse vn x y z
+static bool parse_normal(std::string_view line, ObjChunk &chunk, size_t line_offset)
+{
+    float x, y, z;
+    if (!parse_float(next_token(line), x) || !parse_float(next_token(line), y) || !parse_float(next_token(line), z))
+    {
+        chunk.report(line_offset, "warning: invalid normal format", false);
+        chunk.normals.emplace_back();   // keeps later indices in place
+        return false;
+    }
+
+    chunk.normals.emplace_back(x, y, z);
+    return true;
+}
+
+// vn index of v/vt/vn or v//vn token, added to sum, false if token has none or it is invalid
+static bool add_face_normal(const std::string_view token, const std::vector<Vec3> &all_normals, const size_t total_normals, Vec3 &sum)
+{
+    const size_t first = token.find('/');
+    const size_t second = first == std::string_view::npos ? first : token.find('/', first + 1);
+    if (second == std::string_view::npos)
+    {
+        return false;
+    }
+
+    const auto idx = parse_int(token.substr(second + 1));
+    const auto total = static_cast<int>(total_normals);
+    if (!idx || *idx == 0 || *idx < -total || *idx > total)
+    {
+        return false;
+    }
+
+    sum = sum + all_normals[*idx < 0 ? total + *idx : *idx - 1];
+    return true;
+}
+
+// parse f, indices are resolved against first total_vertices of all_vertices
+// with all_normals given, averaged vn of every face is recorded, zero if some corner has none
+static bool parse_face(std::string_view line, std::optional<int> current_material, const std::vector<Vec3> &all_vertices, size_t total_vertices, const std::vector<Vec3> &all_normals, size_t total_normals, std::vector<unsigned int> &local_indices, ObjChunk &chunk, size_t line_offset)
+{
+    local_indices.clear();
+
+    Vec3 normal_sum;
+    bool have_normals = !all_normals.empty();
+
+    for (std::string_view token = next_token(line); !token.empty(); token = next_token(line))
+    {
+        if (have_normals)
+        {
+            have_normals = add_face_normal(token, all_normals, total_normals, normal_sum);
+        }
+
+        token = token.substr(0, token.find('/')); // keep only first index
+
+        auto maybe_idx = parse_int(token);
+        if (!maybe_idx)
+        {
+            chunk.report(line_offset, "warning: invalid face token " + std::string(token), true);
+            return false;
+        }
+
+        int ridx = relative_index(*maybe_idx, static_cast<int>(total_vertices), chunk, line_offset);
+        if (ridx < 0 || static_cast<size_t>(ridx) >= total_vertices)
+        {
+            chunk.report(line_offset, "warning: vertex index " + std::to_string(*maybe_idx) + " out of range", true);
+            return false;
+        }
+        local_indices.push_back(static_cast<unsigned int>(ridx));
+    }
+
+    if (local_indices.size() < 3)
+    {
+        chunk.report(line_offset, "warning: face contains less than 3 indexes", true);
+        return false;
+    }
+
+    if (!all_normals.empty())
+    {
+        const Vec3 normal = have_normals ? normal_sum.normalize() : Vec3();
+        const size_t triangles = local_indices.size() - 2;
+        chunk.face_normals.insert(chunk.face_normals.end(), triangles, normal);
+    }
+
+    if (local_indices.size() == 3)
+    {
+        chunk.faces.emplace_back(local_indices[0], local_indices[1], local_indices[2], current_material);
+        return true;
+    }
+
+    // triangularization
+    std::vector<Vec3> polygon;
+    polygon.reserve(local_indices.size());
+
+    for (const auto idx : local_indices)
+    {
+        polygon.push_back(all_vertices[idx]);
+    }
+
+    const auto result = triangularize(polygon);
+    if (!result.has_value())
+    {
+        chunk.report(line_offset, "warning: triangularize failed", true);
+        return false;
+    }
+
+    // adding faces
+    const auto &triangle_indices = result.value();
+    for (size_t i = 0; i < triangle_indices.size(); i += 3)
+    {
+        unsigned int i1 = local_indices[ triangle_indices[i] ];
+        unsigned int i2 = local_indices[ triangle_indices[i+1] ];
+        unsigned int i3 = local_indices[ triangle_indices[i+2] ];
+        chunk.faces.emplace_back(i1, i2, i3, current_material);
+    }
+
+    return true;
+}
+
+// tokenizer
+
+std::string_view next_line(std::string_view &text)
+{
+    const size_t end = text.find('\n');
+    const std::string_view line = text.substr(0, end);
+    text.remove_prefix(end == std::string_view::npos ? text.size() : end + 1);
+    return line;
+}
+
+std::string_view next_token(std::string_view &line)
+{
+    size_t begin = 0;
+    while (begin < line.size() && is_blank(line[begin]))
+        begin++;
+
+    size_t end = begin;
+    while (end < line.size() && !is_blank(line[end]))
+        end++;
+
+    const std::string_view token = line.substr(begin, end - begin);
+    line.remove_prefix(end);
+    return token;
+}
+
+std::string_view trim(std::string_view line)
+{
+    while (!line.empty() && is_blank(line.front()))
+        line.remove_prefix(1);
+    while (!line.empty() && is_blank(line.back()))
+        line.remove_suffix(1);
+    return line;
+}
+
+bool parse_float(std::string_view token, float &value)
+{
+    if (!token.empty() && token[0] == '+')
+        token.remove_prefix(1);
+
+    const char *end = token.data() + token.size();
+    const auto [ptr, ec] = std::from_chars(token.data(), end, value);
+    return ec == std::errc() && ptr == end;
+}
+
+// ObjChunk methods
+
+void ObjChunk::report(const size_t line_offset, std::string message, const bool fatal)
+{
+    log.push_back({line_offset, std::move(message), fatal});
+
+    if (fatal)
+    {
+        limit = std::min(limit, line_offset);
+    }
+}
+
+void ObjChunk::scan(const bool color_support, const bool file_normals)
+{
+    std::string_view rest = text;
+
+    while (!rest.empty())
+    {
+        const size_t line_offset = offset + static_cast<size_t>(rest.data() - text.data());
+        std::string_view arguments = next_line(rest);
+        const std::string_view cmd = next_token(arguments);
+
+        if (cmd == "v") // vertex
+        {
+            if (!parse_vertex(arguments, *this, line_offset))
+                return;
+        }
+        else if (file_normals && cmd == "vn") // vertex normal
+        {
+            parse_normal(arguments, *this, line_offset);
+        }
+        else if (color_support && (cmd == "mtllib" || cmd == "usemtl")) // material, resolved in order
+        {
+            events.push_back({line_offset, cmd == "mtllib", arguments, std::nullopt});
+        }
+    }
+}
+
+void ObjChunk::parse_faces(const std::vector<Vec3> &all_vertices, const std::vector<Vec3> &all_normals, const bool color_support)
+{
+    std::string_view rest = text;
+    std::optional<int> current_material = start_material;
+    size_t local_vertices = 0;
+    size_t local_normals = 0;
+    size_t next_event = 0;
+    std::vector<unsigned int> local_indices;    // reused by every face
+
+    while (!rest.empty())
+    {
+        const size_t line_offset = offset + static_cast<size_t>(rest.data() - text.data());
+        if (line_offset >= limit)
+        {
+            return;
+        }
+
+        std::string_view arguments = next_line(rest);
+        const std::string_view cmd = next_token(arguments);
+
+        if (cmd == "v")
+        {
+            local_vertices++;
+        }
+        else if (cmd == "vn")
+        {
+            local_normals++;
+        }
+        else if (cmd == "f")
+        {
+            if (!parse_face(arguments, current_material, all_vertices, vertex_base + local_vertices, all_normals, normal_base + local_normals, local_indices, *this, line_offset))
+                return;
+        }
+        else if (color_support && (cmd == "mtllib" || cmd == "usemtl"))
+        {
+            const MaterialEvent &event = events[next_event++];
+            if (!event.library)
+            {
+                current_material = event.material;
+            }
+        }
+    }
+}
+
+// chunk functions
+
+std::vector<ObjChunk> split_chunks(const std::string_view text, const size_t count)
+{
+    std::vector<ObjChunk> chunks;
+    chunks.reserve(count);
+
+    const size_t target = text.size() / std::max<size_t>(count, 1);
+    size_t begin = 0;
+
+    while (begin < text.size())
+    {
+        size_t end = chunks.size() + 1 < count ? begin + target : text.size();
+
+        // extend to end of line
+        if (end < text.size())
+        {
+            const size_t nl = text.find('\n', end);
+            end = nl == std::string_view::npos ? text.size() : nl + 1;
+        }
+
+        chunks.emplace_back(text.substr(begin, end - begin), begin);
+        begin = end;
+    }
+
+    return chunks;
+}
+
+void for_each_chunk(const std::span<ObjChunk> chunks, const unsigned int threads, const std::function<void(ObjChunk &)> &task, const std::function<void(ObjChunk &)> &commit)
+{
+    std::atomic<size_t> next = 0;
+
+    std::mutex commit_mutex;
+    std::vector<char> finished(chunks.size(), 0);
+    size_t committed = 0;
+
+    auto worker = [&]() {
+        for (size_t i = next++; i < chunks.size(); i = next++)
+        {
+            task(chunks[i]);
+
+            // whoever completes the gap commits everything ready behind it
+            std::lock_guard lock(commit_mutex);
+            finished[i] = 1;
+            while (committed < chunks.size() && finished[committed])
+            {
+                commit(chunks[committed++]);
+            }
+        }
+    };
+
+    const size_t workers = std::min<size_t>(threads, chunks.size());
+
+    std::vector<std::thread> pool;
+    for (size_t i = 1; i < workers; i++)
+    {
+        pool.emplace_back(worker);
+    }
+
+    worker();   // calling thread takes part too
+
+    for (auto &t : pool)
+    {
+        t.join();
+    }
+}
+
+bool flush_diagnostics(const std::vector<ObjChunk> &chunks)
+{
+    for (const auto &chunk : chunks)
+    {
+        // passes append out of line order
+        std::vector<const Diagnostic *> sorted;
+        sorted.reserve(chunk.log.size());
+        for (const auto &d : chunk.log)
+        {
+            sorted.push_back(&d);
+        }
+        std::ranges::stable_sort(sorted, {}, &Diagnostic::offset);
+
+        for (const auto *d : sorted)
+        {
+            if (d->offset > chunk.limit)
+            {
+                break;
+            }
+
+            if (!d->message.empty())
+            {
+                std::cerr << d->message << std::endl;
+            }
+
+            if (d->fatal)
+            {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
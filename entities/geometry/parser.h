@@ -0,0 +1,75 @@
+/*
+ * parser.h
+ */
+
+#pragma once
+
+#include <functional>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "object.h"
+
+// tokenizer over views of mapped text
+std::string_view next_line(std::string_view &text);     // cut next line, without line break
+std::string_view next_token(std::string_view &line);    // cut next whitespace separated token
+std::string_view trim(std::string_view line);           // strip surrounding whitespace
+bool parse_float(std::string_view token, float &value); // whole token to float
+
+// warning or error produced while parsing
+class Diagnostic {
+public:
+    size_t offset;          // offset of line in file
+    std::string message;    // printed text
+    bool fatal;             // stops loading
+};
+
+// mtllib or usemtl line, resolved in file order between passes
+class MaterialEvent {
+public:
+    size_t offset;                  // offset of line in file
+    bool library;                   // mtllib if true, usemtl otherwise
+    std::string_view arguments;     // rest of line
+    std::optional<int> material;    // resolved usemtl material
+};
+
+// line aligned slice of obj file, parsed independently of other slices
+class ObjChunk {
+public:
+    std::string_view text;                  // slice of file
+    size_t offset = 0;                      // offset of slice in file
+    size_t limit = std::string_view::npos;  // offset of first fatal line, nothing after it is parsed
+
+    std::vector<Vec3> vertices;             // vertices of slice
+    std::vector<Vec3> normals;              // vn records of slice, only when requested
+    std::vector<Face> faces;                // triangulated faces of slice
+    std::vector<Vec3> face_normals;         // averaged vn of every face, only when file has normals
+    std::vector<MaterialEvent> events;      // material lines of slice
+    std::vector<Diagnostic> log;            // diagnostics of slice
+
+    size_t vertex_base = 0;                 // vertices before slice
+    size_t normal_base = 0;                 // vn records before slice
+    std::optional<int> start_material;      // active material at start of slice
+
+    ObjChunk(std::string_view text, size_t offset) : text(text), offset(offset) {}
+
+    // first pass - vertices, normals if requested and material lines
+    void scan(bool color_support, bool file_normals);
+
+    // second pass - faces, vertices and normals up to end of chunk must be known
+    void parse_faces(const std::vector<Vec3> &all_vertices, const std::vector<Vec3> &all_normals, bool color_support);
+
+    void report(size_t line_offset, std::string message, bool fatal);
+};
+
+// split text into count line aligned chunks
+std::vector<ObjChunk> split_chunks(std::string_view text, size_t count);
+
+// run task for every chunk on up to threads workers, finished chunks are committed one at a time in file order
+void for_each_chunk(std::span<ObjChunk> chunks, unsigned int threads, const std::function<void(ObjChunk &)> &task, const std::function<void(ObjChunk &)> &commit);
+
+// print diagnostics in file order up to first fatal one, false if loading failed
+bool flush_diagnostics(const std::vector<ObjChunk> &chunks);
@@ -0,0 +1,54 @@
+/*
+ * quantized.cpp
+ */
+
+#include "quantized.h"
+
+#include "packed.h"
+
+#include <algorithm>
+#include <limits>
+
+inline constexpr float CODE_MAX = std::numeric_limits<uint16_t>::max();
+
+template<typename Positions>
+QuantizedPositions::QuantizedPositions(const Positions &positions)
+{
+    if (positions.size() == 0)
+    {
+        return;
+    }
+
+    Vec3 vmin = positions[0];
+    Vec3 vmax = positions[0];
+
+    for (size_t i = 0; i < positions.size(); i++)
+    {
+        const Vec3 v = positions[i];
+        vmin = Vec3(std::min(vmin.x, v.x), std::min(vmin.y, v.y), std::min(vmin.z, v.z));
+        vmax = Vec3(std::max(vmax.x, v.x), std::max(vmax.y, v.y), std::max(vmax.z, v.z));
+    }
+
+    offset = vmin;
+    step = Vec3((vmax.x - vmin.x) / CODE_MAX, (vmax.y - vmin.y) / CODE_MAX, (vmax.z - vmin.z) / CODE_MAX);
+
+    auto encode = [](const float value, const float min, const float step) -> uint16_t {
+        return step > 0.0f ? static_cast<uint16_t>(std::clamp(std::round((value - min) / step), 0.0f, CODE_MAX)) : 0;
+    };
+
+    codes.reserve(positions.size());
+    for (size_t i = 0; i < positions.size(); i++)
+    {
+        const Vec3 v = positions[i];
+        codes.push_back({encode(v.x, vmin.x, step.x), encode(v.y, vmin.y, step.y), encode(v.z, vmin.z, step.z)});
+    }
+}
+
+template QuantizedPositions::QuantizedPositions(const std::vector<Vec3> &);
+template QuantizedPositions::QuantizedPositions(const PlanarPositions &);
+
+float QuantizedPositions::max_error() const
+{
+    // rounding moves every axis by half a step at most
+    return (step * 0.5f).magnitude();
+}
@@ -0,0 +1,40 @@
+/*
+ * quantized.h
+ */
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include "utils/mathematics.h"
+
+// vertex positions as 16-bit fixed point within their bounding box
+class QuantizedPositions {
+public:
+    Vec3 offset;                                // position of code 0
+    Vec3 step;                                  // position change per code
+    std::vector<std::array<uint16_t, 3>> codes;
+
+    QuantizedPositions() = default;
+
+    // from vertices or planar positions
+    template<typename Positions>
+    explicit QuantizedPositions(const Positions &positions);
+
+    [[nodiscard]] size_t size() const { return codes.size(); }
+
+    [[nodiscard]] Vec3 operator[](const size_t i) const
+    {
+        const auto &q = codes[i];
+        return {
+            offset.x + static_cast<float>(q[0]) * step.x,
+            offset.y + static_cast<float>(q[1]) * step.y,
+            offset.z + static_cast<float>(q[2]) * step.z
+        };
+    }
+
+    // largest distance between original and decoded position
+    [[nodiscard]] float max_error() const;
+};
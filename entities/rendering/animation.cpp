@@ -0,0 +1,320 @@
+/*
+ * animation.cpp
+ */
+
+#include "animation.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+
+#include "buffer.h"
+#include "rasterizer.h"
+#include "renderer.h"
+#include "utils/algorithms.h"
+#include "utils/mapped_file.h"
+#include "utils/thread_pool.h"
+#include "config.h"
+
+// file layout, native byte order:
+// header | palette (3 x f32 per material slot) | frames (u32 size, encoded changes)
+//
+// encoded frame is list of runs covering all cells in row order, every run starts with varint
+// of cell count shifted left by two and kind in low bits, cells are u16 as in Buffer::cells
+
+inline constexpr char ANIMATION_MAGIC[4] = {'O', 'B', 'J', 'T'};
+inline constexpr uint32_t ANIMATION_VERSION = 1;
+
+inline constexpr uint64_t RUN_SKIP = 0;     // cells unchanged
+inline constexpr uint64_t RUN_REPEAT = 1;   // one cell repeated
+inline constexpr uint64_t RUN_LITERAL = 2;  // cells one by one
+inline constexpr size_t RUN_REPEAT_MIN = 3; // shorter repeats are stored as literals
+
+struct AnimationHeader {
+    char magic[4];
+    uint32_t version;       // format version, also detects byte order
+    uint32_t width;
+    uint32_t height;
+    uint32_t interval_ms;
+    uint32_t frame_count;
+    uint32_t palette_count;
+};
+
+// helper functions
+
+static void put_varint(std::string &out, uint64_t value)
+{
+    while (value >= 0x80)
+    {
+        out += static_cast<char>(value | 0x80);
+        value >>= 7;
+    }
+
+    out += static_cast<char>(value);
+}
+
+static bool get_varint(std::string_view &in, uint64_t &value)
+{
+    value = 0;
+
+    for (int shift = 0; shift < 64; shift += 7)
+    {
+        if (in.empty())
+            return false;
+
+        const auto byte = static_cast<uint8_t>(in[0]);
+        in.remove_prefix(1);
+
+        value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+        if (!(byte & 0x80))
+            return true;
+    }
+
+    return false;
+}
+
+static void put_cell(std::string &out, const uint16_t cell)
+{
+    out.append(reinterpret_cast<const char *>(&cell), sizeof(cell));
+}
+
+static bool get_cell(std::string_view &in, uint16_t &cell)
+{
+    if (in.size() < sizeof(cell))
+        return false;
+
+    std::memcpy(&cell, in.data(), sizeof(cell));
+    in.remove_prefix(sizeof(cell));
+    return true;
+}
+
+// bounds checked read from mapped file
+static bool take(std::string_view &data, void *out, size_t size)
+{
+    if (data.size() < size)
+        return false;
+
+    std::memcpy(out, data.data(), size);
+    data.remove_prefix(size);
+    return true;
+}
+
+// Animation methods
+
+Animation Animation::bake(const Object &obj, const Camera &cam, const unsigned int width, const unsigned int height, const bool static_light, const bool color_support, const unsigned int threads)
+{
+    Animation animation;
+    animation.width = width;
+    animation.height = height;
+    animation.interval_ms = FRAME_INTERVAL_MS;
+
+    if (color_support)
+    {
+        animation.palette = obj.materials;
+    }
+
+    const auto count = static_cast<size_t>(std::lround(360.0f / ANGLE_STEP));
+    const float logical_y = 2.0f;
+    const float logical_x = logical_y * static_cast<float>(width) / (static_cast<float>(height) * CHAR_ASPECT_RATIO);
+
+    std::vector<std::vector<uint16_t>> cells(count);
+    ThreadPool pool(threads);
+
+    // frames are independent, every one is rendered whole by one thread
+    pool.run(count, [&](const size_t i) {
+        Buffer buf(width, height, logical_x, logical_y);
+        TileRasterizer rasterizer(1);
+        const Camera view(cam.azimuth + deg2rad(ANGLE_STEP) * static_cast<float>(i), cam.altitude, cam.zoom);
+
+        Renderer::render(buf, obj, view, Light(), static_light, color_support, 0, &rasterizer);
+        cells[i] = std::move(buf.cells);
+    });
+
+    const std::vector<uint16_t> blank(static_cast<size_t>(width) * height, Cell::blank);
+    animation.frames.resize(count);
+
+    pool.run(count, [&](const size_t i) {
+        animation.frames[i] = encode(i == 0 ? blank : cells[i - 1], cells[i]);
+    });
+
+    return animation;
+}
+
+std::optional<Animation> Animation::load(const std::filesystem::path &path)
+{
+    MappedFile file;
+    if (!file.open(path.string()))
+        return std::nullopt;
+
+    std::string_view data = file.view();
+
+    AnimationHeader header {};
+    if (!take(data, &header, sizeof(header)) ||
+        std::memcmp(header.magic, ANIMATION_MAGIC, sizeof(ANIMATION_MAGIC)) != 0 ||
+        header.version != ANIMATION_VERSION ||
+        header.width == 0 || header.height == 0 ||
+        header.width > FRAME_MAX_SIDE || header.height > FRAME_MAX_SIDE ||
+        header.palette_count > data.size() / sizeof(Vec3))
+    {
+        return std::nullopt;
+    }
+
+    Animation animation;
+    animation.width = header.width;
+    animation.height = header.height;
+    animation.interval_ms = header.interval_ms;
+
+    for (uint32_t i = 0; i < header.palette_count; i++)
+    {
+        Vec3 diffuse;
+        take(data, &diffuse, sizeof(diffuse));
+        animation.palette.emplace_back("", diffuse);
+    }
+
+    for (uint32_t i = 0; i < header.frame_count; i++)
+    {
+        uint32_t size = 0;
+        if (!take(data, &size, sizeof(size)) || data.size() < size)
+            return std::nullopt;
+
+        animation.frames.emplace_back(data.substr(0, size));
+        data.remove_prefix(size);
+    }
+
+    return animation;
+}
+
+bool Animation::save(const std::filesystem::path &path) const
+{
+    AnimationHeader header {};
+    std::memcpy(header.magic, ANIMATION_MAGIC, sizeof(ANIMATION_MAGIC));
+    header.version = ANIMATION_VERSION;
+    header.width = width;
+    header.height = height;
+    header.interval_ms = interval_ms;
+    header.frame_count = static_cast<uint32_t>(frames.size());
+    header.palette_count = static_cast<uint32_t>(palette.size());
+
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out)
+        return false;
+
+    out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+
+    for (const auto &m : palette)
+    {
+        out.write(reinterpret_cast<const char *>(&m.diffuse), sizeof(m.diffuse));
+    }
+
+    for (const auto &frame : frames)
+    {
+        const auto size = static_cast<uint32_t>(frame.size());
+        out.write(reinterpret_cast<const char *>(&size), sizeof(size));
+        out.write(frame.data(), size);
+    }
+
+    return static_cast<bool>(out.flush());
+}
+
+std::string Animation::encode(const std::vector<uint16_t> &previous, const std::vector<uint16_t> &cells)
+{
+    std::string out;
+    const size_t count = cells.size();
+
+    size_t i = 0;
+    while (i < count)
+    {
+        size_t end = i;
+
+        if (cells[i] == previous[i])
+        {
+            while (end < count && cells[end] == previous[end])
+            {
+                end++;
+            }
+
+            put_varint(out, (end - i) << 2 | RUN_SKIP);
+            i = end;
+            continue;
+        }
+
+        while (end < count && cells[end] == cells[i])
+        {
+            end++;
+        }
+
+        if (end - i >= RUN_REPEAT_MIN)
+        {
+            put_varint(out, (end - i) << 2 | RUN_REPEAT);
+            put_cell(out, cells[i]);
+            i = end;
+            continue;
+        }
+
+        // changed cells until unchanged one or start of repeat
+        end = i;
+        while (end < count && cells[end] != previous[end] &&
+               !(end + RUN_REPEAT_MIN <= count && std::equal(cells.begin() + end + 1, cells.begin() + end + RUN_REPEAT_MIN, cells.begin() + end)))
+        {
+            end++;
+        }
+
+        // cell at i starts no repeat, so at least it is taken
+        end = std::max(end, i + 1);
+
+        put_varint(out, (end - i) << 2 | RUN_LITERAL);
+        for (size_t k = i; k < end; k++)
+        {
+            put_cell(out, cells[k]);
+        }
+
+        i = end;
+    }
+
+    return out;
+}
+
+bool Animation::decode(std::string_view frame, std::vector<uint16_t> &cells)
+{
+    size_t i = 0;
+
+    while (!frame.empty())
+    {
+        uint64_t run = 0;
+        if (!get_varint(frame, run))
+            return false;
+
+        const uint64_t length = run >> 2;
+        if (length > cells.size() - i)
+            return false;
+
+        uint16_t cell = 0;
+        switch (run & 3)
+        {
+            case RUN_SKIP:
+                break;
+
+            case RUN_REPEAT:
+                if (!get_cell(frame, cell))
+                    return false;
+                std::fill_n(cells.begin() + static_cast<std::ptrdiff_t>(i), length, cell);
+                break;
+
+            case RUN_LITERAL:
+                for (uint64_t k = 0; k < length; k++)
+                {
+                    if (!get_cell(frame, cells[i + k]))
+                        return false;
+                }
+                break;
+
+            default:
+                return false;
+        }
+
+        i += length;
+    }
+
+    return i == cells.size();
+}
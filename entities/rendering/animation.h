@@ -0,0 +1,36 @@
+/*
+ * animation.h
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "entities/geometry/object.h"
+#include "entities/view/camera.h"
+
+// prerendered turntable (.objt), every frame stored as changes of cells against previous one
+class Animation {
+public:
+    unsigned int width = 0, height = 0;     // frame size in characters
+    unsigned int interval_ms = 0;           // time between frames
+    std::vector<Material> palette;          // material slots as colors, empty if frames are not colored
+    std::vector<std::string> frames;        // encoded frames, first one against blank screen
+
+    // full turn of camera in ANGLE_STEP steps starting at cam, frames rendered on all threads
+    static Animation bake(const Object &obj, const Camera &cam, unsigned int width, unsigned int height, bool static_light, bool color_support, unsigned int threads);
+
+    static std::optional<Animation> load(const std::filesystem::path &path);
+    bool save(const std::filesystem::path &path) const;
+
+    // changes turning previous cells into cells
+    static std::string encode(const std::vector<uint16_t> &previous, const std::vector<uint16_t> &cells);
+
+    // applies encoded changes to cells, false if frame is corrupt
+    static bool decode(std::string_view frame, std::vector<uint16_t> &cells);
+};
@@ -4,69 +4,33 @@
 
 #include "buffer.h"
 
-#include <array>
+#include "config.h"
 
-// Projection methods
+// helper functions
 
-Projection Projection::sort_x() const
+// floor and ceiling of integer division by positive divisor
+static int64_t floor_div(const int64_t a, const int64_t b)
 {
-    std::array arr = {p1, p2, p3};
-
-    std::ranges::sort(arr, [](const Vec3 &a, const Vec3 &b) { return a.x < b.x; });
-
-    return {arr[0], arr[1], arr[2], color};
+    return a / b - (a % b != 0 && a < 0);
 }
 
-float Projection::limit_y1(const float x) const
+static int64_t ceil_div(const int64_t a, const int64_t b)
 {
-    if (x <= p1.x) return p1.y;
-    if (x >= p3.x) return p3.y;
-
-    if (x <= p2.x)
-    {
-        const float denominator = p2.x - p1.x;
-
-        if (std::fabs(denominator) < 1e-7f)
-            return p1.y;
-
-        const float t = (x - p1.x) / denominator;
-        return lerp(p1.y, p2.y, t);
-    }
-    else
-    {
-        const float denominator = p3.x - p2.x;
-
-        if (std::fabs(denominator) < 1e-7f)
-            return p2.y;
-
-        const float t = (x - p2.x) / denominator;
-        return lerp(p2.y, p3.y, t);
-    }
+    return a / b + (a % b != 0 && a > 0);
 }
 
-float Projection::limit_y2(const float x) const
-{
-    if (x <= p1.x)
-        return p1.y;
-    if (x >= p3.x)
-        return p3.y;
-
-    const float denominator = p3.x - p1.x;
-
-    if (std::fabs(denominator) < 1e-7f)
-        return p1.y;
+// RasterStats methods
 
-    const float t = (x - p1.x) / denominator;
-    return lerp(p1.y, p3.y, t);
-}
-
-Vec3 Projection::normal() const
+RasterStats &RasterStats::operator+=(const RasterStats &other)
 {
-    const Vec3 v1 = p2 - p1;
-    const Vec3 v2 = p3 - p1;
-    const Vec3 n = Vec3::cross(v1, v2);
-
-    return n.normalize();
+    triangles += other.triangles;
+    draws += other.draws;
+    rejected += other.rejected;
+    tested += other.tested;
+    written += other.written;
+    covered += other.covered;
+
+    return *this;
 }
 
 // Buffer methods
@@ -80,121 +44,271 @@ Buffer::Buffer(const unsigned int x, const unsigned int y, const float logical_x
 
     dx = logical_x / static_cast<float>(x);
     dy = logical_y / static_cast<float>(y);
+    inv_dx = 1.0f / dx;
+    inv_dy = 1.0f / dy;
 
-    pixels.resize(x * y);
+    depth.resize(x * y);
+    cells.resize(x * y);
+
+    depth_x = (x + DEPTH_TILE_WIDTH - 1) / DEPTH_TILE_WIDTH;
+    depth_y = (y + DEPTH_TILE_HEIGHT - 1) / DEPTH_TILE_HEIGHT;
+    tile_depth.resize(depth_x * depth_y);
+    tile_dirty.resize(depth_x * depth_y);
 
     clear();
 }
 
 void Buffer::clear()
 {
-    for (auto &p : pixels)
-    {
-        p.z = std::numeric_limits<float>::max();
-        p.c = ' ';
-        p.material = std::nullopt;
-    }
+    std::ranges::fill(depth, std::numeric_limits<float>::max());
+    std::ranges::fill(cells, Cell::blank);
+    std::ranges::fill(tile_depth, std::numeric_limits<float>::max());
+    std::ranges::fill(tile_dirty, 0);
 }
 
-int Buffer::index_x(const float real_x) const
+std::optional<TriangleSetup> Buffer::setup(const Projection &projection) const
 {
-    int index = static_cast<int>(real_x / dx);
-    index = clamp(index, 0, static_cast<int>(x) - 1);
+    constexpr int64_t one = int64_t{1} << RASTER_SUBPIXEL_BITS;  // cell in fixed point
+    constexpr int64_t half = one / 2;
+    constexpr auto guard = static_cast<int64_t>(RASTER_GUARD_BAND) * one;
 
-    return index;
-}
+    // vertices snapped to fixed point cell units
+    std::array<Vec3, 3> v = {projection.p1, projection.p2, projection.p3};
+    std::array<int64_t, 3> fx {};
+    std::array<int64_t, 3> fy {};
 
-int Buffer::index_y(const float real_y) const
-{
-    int iy = static_cast<int>(real_y / dy);
-    iy = clamp(iy, 0, static_cast<int>(y) - 1);
+    for (size_t i = 0; i < 3; i++)
+    {
+        const float cx = v[i].x * inv_dx;
+        const float cy = v[i].y * inv_dy;
 
-    return iy;
-}
+        // nothing is clipped inside guard band, also rejects nan
+        if (!(std::fabs(cx) <= RASTER_GUARD_BAND && std::fabs(cy) <= RASTER_GUARD_BAND))
+            return std::nullopt;
 
-float Buffer::depth(const Projection &projection, const Vec3 &normal, const int pixel_x, const int pixel_y) const
-{
-    const float center_x = (static_cast<float>(pixel_x) + 0.5f) * dx;
-    const float center_y = (static_cast<float>(pixel_y) + 0.5f) * dy;
+        // rounding of positive values by truncation, shifted back after
+        fx[i] = static_cast<int64_t>((static_cast<double>(cx) + RASTER_GUARD_BAND) * one + 0.5) - guard;
+        fy[i] = static_cast<int64_t>((static_cast<double>(cy) + RASTER_GUARD_BAND) * one + 0.5) - guard;
+    }
+
+    // cells with centers inside bounding box, limited to screen, most faces of dense meshes end here
+    TriangleSetup t {};
+
+    t.bounds.x0 = static_cast<int>(std::max<int64_t>(ceil_div(std::min({fx[0], fx[1], fx[2]}) - half, one), 0));
+    t.bounds.y0 = static_cast<int>(std::max<int64_t>(ceil_div(std::min({fy[0], fy[1], fy[2]}) - half, one), 0));
+    t.bounds.x1 = static_cast<int>(std::min<int64_t>(floor_div(std::max({fx[0], fx[1], fx[2]}) - half, one), x - 1));
+    t.bounds.y1 = static_cast<int>(std::min<int64_t>(floor_div(std::max({fy[0], fy[1], fy[2]}) - half, one), y - 1));
 
-    if (std::fabs(normal.z) < 1e-7f)
+    if (t.bounds.x0 > t.bounds.x1 || t.bounds.y0 > t.bounds.y1)
+        return std::nullopt;
+
+    // counterclockwise in screen space, degenerate triangles cover nothing
+    int64_t area = (fx[1] - fx[0]) * (fy[2] - fy[0]) - (fy[1] - fy[0]) * (fx[2] - fx[0]);
+    if (area == 0)
+        return std::nullopt;
+
+    if (area < 0)
     {
-        return projection.p1.z;
+        std::swap(v[1], v[2]);
+        std::swap(fx[1], fx[2]);
+        std::swap(fy[1], fy[2]);
+        area = -area;
     }
 
-    const float d_z = normal.x * (center_x - projection.p1.x) + normal.y * (center_y - projection.p1.y);
-    const float z  = projection.p1.z - d_z / normal.z;
+    // edge functions over cell centers, positive inside
+    for (size_t i = 0; i < 3; i++)
+    {
+        const size_t j = (i + 1) % 3;
+        const int64_t ex = fy[i] - fy[j];
+        const int64_t ey = fx[j] - fx[i];
 
-    return z;
+        // centers exactly on edge belong to triangle below or right of it, so shared edges are drawn once
+        const bool inclusive = ey < 0 || (ey == 0 && ex < 0);
+
+        t.edge_x[i] = ex * one;
+        t.edge_y[i] = ey * one;
+        t.edge_0[i] = ex * (half - fx[i]) + ey * (half - fy[i]) - (inclusive ? 0 : 1);
+    }
+
+    // depth plane over snapped vertices
+    std::array<float, 3> sx {};
+    std::array<float, 3> sy {};
+
+    for (size_t i = 0; i < 3; i++)
+    {
+        sx[i] = static_cast<float>(fx[i]) / static_cast<float>(one);
+        sy[i] = static_cast<float>(fy[i]) / static_cast<float>(one);
+    }
+
+    const float inv_area = static_cast<float>(one * one) / static_cast<float>(area);
+    const float z1 = v[1].z - v[0].z;
+    const float z2 = v[2].z - v[0].z;
+
+    t.z_x = (z1 * (sy[2] - sy[0]) - z2 * (sy[1] - sy[0])) * inv_area;
+    t.z_y = (z2 * (sx[1] - sx[0]) - z1 * (sx[2] - sx[0])) * inv_area;
+    t.z0 = v[0].z + t.z_x * (0.5f - sx[0]) + t.z_y * (0.5f - sy[0]);
+    t.z_min = std::min({v[0].z, v[1].z, v[2].z});
+
+    return t;
+}
+
+void Buffer::draw_projection(const Projection &projection, const char c, const int material)
+{
+    if (const auto triangle = setup(projection))
+    {
+        RasterStats stats;
+        draw_triangle(*triangle, c, material, {0, 0, static_cast<int>(x) - 1, static_cast<int>(y) - 1}, stats);
+    }
 }
 
-void Buffer::draw_projection(const Projection &projection, const char c, int material)
+void Buffer::draw_triangle(const TriangleSetup &triangle, const char c, const int material, const PixelRect &clip, RasterStats &stats)
 {
-    const Projection triangle = projection.sort_x();
+    const int x_start = std::max(triangle.bounds.x0, clip.x0);
+    const int x_end = std::min(triangle.bounds.x1, clip.x1);
+    const int y_start = std::max(triangle.bounds.y0, clip.y0);
+    const int y_end = std::min(triangle.bounds.y1, clip.y1);
+
+    stats.draws++;
 
-    const float x_i = triangle.p1.x + dx * 0.5f;
-    const float x_f = triangle.p3.x - dx * 0.5f;
-    if (x_f < 0.f || x_i > logical_x)
+    // whole extent behind what is already drawn
+    if (occluded(triangle.z_min, {x_start, y_start, x_end, y_end}))
+    {
+        stats.rejected++;
         return;
+    }
 
-    const int x_start = index_x(x_i);
-    const int x_end   = index_x(x_f);
+    const uint16_t cell = Cell::pack(c, material);
 
-    const Vec3 normal = triangle.normal();
+    std::array<int64_t, 3> edge {};
+    for (size_t i = 0; i < 3; i++)
+    {
+        edge[i] = triangle.edge_0[i] + triangle.edge_y[i] * y_start;
+    }
 
-    for (int pixel_x = x_start; pixel_x <= x_end; pixel_x++)
+    for (int pixel_y = y_start; pixel_y <= y_end; pixel_y++)
     {
-        const float rx = (static_cast<float>(pixel_x) + 0.5f) * dx;
+        // span of row where every edge function is not negative
+        int64_t first = x_start;
+        int64_t last = x_end;
 
-        float y1 = triangle.limit_y1(rx);
-        float y2 = triangle.limit_y2(rx);
+        for (size_t i = 0; i < 3; i++)
+        {
+            if (triangle.edge_x[i] > 0)
+                first = std::max(first, ceil_div(-edge[i], triangle.edge_x[i]));
+            else if (triangle.edge_x[i] < 0)
+                last = std::min(last, floor_div(edge[i], -triangle.edge_x[i]));
+            else if (edge[i] < 0)
+                last = first - 1;
+
+            edge[i] += triangle.edge_y[i];
+        }
 
-        const float y_min = std::min(y1, y2);
-        const float y_max = std::max(y1, y2);
+        // depth depends on cell only, so clipped and whole draws agree
+        const float z_row = triangle.z0 + triangle.z_y * static_cast<float>(pixel_y);
+        float *const row_depth = &depth[static_cast<size_t>(pixel_y) * x];
+        uint16_t *const row_cells = &cells[static_cast<size_t>(pixel_y) * x];
+        uint8_t *const dirty = &tile_dirty[static_cast<size_t>(pixel_y / DEPTH_TILE_HEIGHT) * depth_x];
+
+        for (int64_t pixel_x = first; pixel_x <= last; pixel_x++)
+        {
+            if (const float z = z_row + triangle.z_x * static_cast<float>(pixel_x); z < row_depth[pixel_x])
+            {
+                row_depth[pixel_x] = z;
+                row_cells[pixel_x] = cell;
 
-        if (y_max < 0.f || y_min > logical_y)
-            continue;
+                dirty[pixel_x / DEPTH_TILE_WIDTH] = 1;
+                stats.written++;
+            }
+        }
 
-        const float y_start_val = y_min + dy * 0.5f;
-        const float y_end_val = y_max - dy * 0.5f;
+        stats.tested += static_cast<size_t>(std::max<int64_t>(last - first + 1, 0));
+    }
+}
 
-        const int y_start = index_y(y_start_val);
-        const int y_end = index_y(y_end_val);
+size_t Buffer::covered(const PixelRect &rect) const
+{
+    size_t count = 0;
 
-        for (int pixel_y = y_start; pixel_y <= y_end; pixel_y++)
+    for (int pixel_y = rect.y0; pixel_y <= rect.y1; pixel_y++)
+    {
+        for (int pixel_x = rect.x0; pixel_x <= rect.x1; pixel_x++)
         {
-            Pixel &pixel = pixels[pixel_y * x + pixel_x];
+            count += Cell::glyph(cells[static_cast<size_t>(pixel_y) * x + pixel_x]) != ' ';
+        }
+    }
+
+    return count;
+}
 
-            if (const float z = depth(triangle, normal, pixel_x, pixel_y); z < pixel.z)
+bool Buffer::occluded(const float z, const PixelRect &rect)
+{
+    for (int ty = rect.y0 / DEPTH_TILE_HEIGHT; ty <= rect.y1 / DEPTH_TILE_HEIGHT; ty++)
+    {
+        for (int tx = rect.x0 / DEPTH_TILE_WIDTH; tx <= rect.x1 / DEPTH_TILE_WIDTH; tx++)
+        {
+            const size_t tile = static_cast<size_t>(ty) * depth_x + tx;
+
+            // stale bound is refreshed only when it decides
+            if (z < tile_depth[tile] && tile_dirty[tile])
             {
-                pixel.z = z;
-                pixel.c = c;
-                pixel.material = material;
+                refresh(tile);
+            }
+
+            if (z < tile_depth[tile])
+            {
+                return false;
             }
         }
     }
+
+    return true;
+}
+
+void Buffer::refresh(const size_t tile)
+{
+    const unsigned int x0 = static_cast<unsigned int>(tile % depth_x) * DEPTH_TILE_WIDTH;
+    const unsigned int y0 = static_cast<unsigned int>(tile / depth_x) * DEPTH_TILE_HEIGHT;
+    const unsigned int x1 = std::min(x0 + DEPTH_TILE_WIDTH, x);
+    const unsigned int y1 = std::min(y0 + DEPTH_TILE_HEIGHT, y);
+
+    float farthest = -std::numeric_limits<float>::max();
+
+    for (unsigned int pixel_y = y0; pixel_y < y1 && farthest < std::numeric_limits<float>::max(); pixel_y++)
+    {
+        for (unsigned int pixel_x = x0; pixel_x < x1; pixel_x++)
+        {
+            farthest = std::max(farthest, depth[pixel_y * x + pixel_x]);
+        }
+    }
+
+    tile_depth[tile] = farthest;
+    tile_dirty[tile] = 0;
 }
 
 void Buffer::printw() const
 {
+    // one row at a time, color pairs embedded in characters
+    std::vector<chtype> line(x);
+
     for (unsigned int row = 0; row < y; row++)
     {
-        ::move(static_cast<int>(row), 0);
+        const uint16_t *const row_cells = &cells[row * x];
 
         for (unsigned int col = 0; col < x; col++)
         {
-            const Pixel &pixel = pixels[row * x + col];
+            const uint16_t cell = row_cells[col];
+            const chtype c = static_cast<unsigned char>(Cell::glyph(cell));
 
-            if (const int color = pixel.material.has_value() ? (pixel.material.value() + 1) : 0; color > 0 && color < COLORS && color < COLOR_PAIRS)
+            if (const int color = Cell::slot(cell); color > 0 && color < COLORS && color < COLOR_PAIRS)
             {
-                attron(COLOR_PAIR(color));
-                ::printw("%c", pixel.c);
-                attroff(COLOR_PAIR(color));
+                line[col] = c | COLOR_PAIR(color);
             }
             else
             {
-                ::printw("%c", pixel.c);
+                line[col] = c;
             }
         }
+
+        mvaddchnstr(static_cast<int>(row), 0, line.data(), static_cast<int>(x));
     }
-}
\ No newline at end of file
+}
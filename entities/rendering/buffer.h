@@ -4,6 +4,8 @@
 
 #pragma once
 
+#include <array>
+#include <cstdint>
 #include <optional>
 #include <vector>
 #include <cmath>
@@ -15,15 +17,25 @@
 #include "utils/mathematics.h"
 #include "utils/algorithms.h"
 
-// screen pixel
-class Pixel {
+// screen cell packed into 16 bits, character in low byte, material slot in high byte
+class Cell {
 public:
-    float z;                        // depth (z-coordinate)
-    char c;                         // character
-    std::optional<int> material;    // material index
+    static constexpr uint16_t blank = ' ';  // space without material
 
-    Pixel() : z(std::numeric_limits<float>::max()), c(' '), material(std::nullopt) {}
-    Pixel(const float z, const char c, const std::optional<int> material = std::nullopt) : z(z), c(c), material(material) {}
+    // slot 0 is no material, COLOR_PAIR holds 8 bits so materials past slot 255 could not be colored anyway
+    static constexpr uint16_t pack(const char c, const int material)
+    {
+        const uint16_t slot = material >= 0 && material < 255 ? static_cast<uint16_t>(material + 1) : 0;
+        return static_cast<uint16_t>(slot << 8 | static_cast<unsigned char>(c));
+    }
+
+    static constexpr char glyph(const uint16_t cell) { return static_cast<char>(cell & 0xff); }
+    static constexpr int slot(const uint16_t cell) { return cell >> 8; }  // material + 1, 0 for none
+
+    static constexpr std::optional<int> material(const uint16_t cell)
+    {
+        return slot(cell) ? std::optional<int>(slot(cell) - 1) : std::nullopt;
+    }
 };
 
 // projection of triangle onto screen
@@ -33,11 +45,40 @@ public:
     char color;      // color of triangle
 
     Projection(const Vec3 &p1, const Vec3 &p2, const Vec3 &p3, const char color) : p1(p1), p2(p2), p3(p3), color(color) {}
+};
+
+// inclusive rectangle of character cells
+class PixelRect {
+public:
+    int x0, y0;
+    int x1, y1;
+};
+
+// triangle prepared for rasterization, cell is covered when its center is inside
+class TriangleSetup {
+public:
+    PixelRect bounds;                   // cells on screen that may be covered
+    std::array<int64_t, 3> edge_x;      // edge function steps per column
+    std::array<int64_t, 3> edge_y;      // edge function steps per row
+    std::array<int64_t, 3> edge_0;      // edge functions at cell (0, 0), negative outside
+    float z0, z_x, z_y;                 // depth at cell (0, 0) and steps per column and row
+    float z_min;                        // nearest vertex
+};
+
+// work done by rasterization
+class RasterStats {
+public:
+    size_t triangles = 0;   // triangles reaching screen
+    size_t draws = 0;       // triangle draws, one per covered tile when tiled
+    size_t rejected = 0;    // draws hidden behind hierarchical depth
+    size_t tested = 0;      // depth tests of covered cells
+    size_t written = 0;     // cells written
+    size_t covered = 0;     // cells lit at end of frame
+
+    // cell writes per lit cell
+    [[nodiscard]] float overdraw() const { return covered ? static_cast<float>(written) / static_cast<float>(covered) : 0.0f; }
 
-    [[nodiscard]] Projection sort_x() const;
-    [[nodiscard]] float limit_y1(float x) const;
-    [[nodiscard]] float limit_y2(float x) const;
-    [[nodiscard]] Vec3 normal() const;
+    RasterStats &operator+=(const RasterStats &other);
 };
 
 // screen buffer
@@ -46,17 +87,33 @@ public:
     unsigned int x, y;          // character buffer size
     float logical_x, logical_y; // logical buffer size
     float dx, dy;               // logical character size
-    std::vector<Pixel> pixels;  // pixel Buffer
+    std::vector<float> depth;       // depth plane, row major
+    std::vector<uint16_t> cells;    // cell plane packed by Cell, row major
 
     Buffer(unsigned int x, unsigned int y, float logical_x, float logical_y);
 
     void clear();
     void draw_projection(const Projection &projection, char c, int material);
+    void draw_triangle(const TriangleSetup &triangle, char c, int material, const PixelRect &clip, RasterStats &stats); // only cells inside clip
     void printw() const;
 
+    [[nodiscard]] char glyph(const unsigned int col, const unsigned int row) const { return Cell::glyph(cells[row * x + col]); }
+    [[nodiscard]] std::optional<int> material(const unsigned int col, const unsigned int row) const { return Cell::material(cells[row * x + col]); }
+
+    // edge and depth gradients of projection, none if it covers no cell of screen
+    [[nodiscard]] std::optional<TriangleSetup> setup(const Projection &projection) const;
+
+    // lit cells inside rectangle
+    [[nodiscard]] size_t covered(const PixelRect &rect) const;
+
 private:
-    [[nodiscard]] int index_x(float real_x) const;
-    [[nodiscard]] int index_y(float real_y) const;
-    [[nodiscard]] float depth(const Projection &projection, const Vec3 &normal, int pixel_x, int pixel_y) const;
+    float inv_dx = 0.0f, inv_dy = 0.0f;     // cells per logical unit
+
+    // hierarchical depth, farthest depth of every tile of cells, tiles are refreshed lazily after writes
+    unsigned int depth_x = 0, depth_y = 0;  // tiles per row and column
+    std::vector<float> tile_depth;          // bound on depth of tile, may be stale but never too near
+    std::vector<uint8_t> tile_dirty;        // written since tile_depth was refreshed
 
+    [[nodiscard]] bool occluded(float z, const PixelRect &rect);   // nothing nearer than z can pass inside rect
+    void refresh(size_t tile);
 };
@@ -0,0 +1,104 @@
+/*
+ * frame_cache.cpp
+ */
+
+#include "frame_cache.h"
+
+#include <cmath>
+
+#include "animation.h"
+#include "config.h"
+
+// FrameCache methods
+
+FrameCache::FrameCache(const size_t capacity) : capacity(capacity) {}
+
+uint64_t FrameCache::key(const Camera &cam, const Buffer &buf)
+{
+    // steps are counted from zero, sums of float steps drift slightly off exact angles
+    const auto turn = static_cast<long>(std::lround(360.0f / ANGLE_STEP));
+    const long azimuth = ((std::lround(rad2deg(cam.azimuth) / ANGLE_STEP) % turn) + turn) % turn;
+    const long altitude = std::lround(rad2deg(cam.altitude) / ANGLE_STEP) + turn;
+    const long zoom = std::lround(cam.zoom / ZOOM_STEP);
+
+    return static_cast<uint64_t>(azimuth & 0xffff) << 48 |
+           static_cast<uint64_t>(altitude & 0xffff) << 32 |
+           static_cast<uint64_t>(zoom & 0xff) << 24 |
+           static_cast<uint64_t>(buf.x & 0xfff) << 12 |
+           static_cast<uint64_t>(buf.y & 0xfff);
+}
+
+bool FrameCache::find(const uint64_t key, Buffer &buf)
+{
+    const auto it = index.find(key);
+    if (it == index.end())
+    {
+        counts.misses++;
+        return false;
+    }
+
+    // keys wrap past 4095 columns or rows, encoded frame of other size fails to decode
+    std::ranges::fill(buf.cells, Cell::blank);
+    if (!Animation::decode(it->second->cells, buf.cells))
+    {
+        counts.misses++;
+        return false;
+    }
+
+    entries.splice(entries.begin(), entries, it->second);
+    counts.hits++;
+    return true;
+}
+
+void FrameCache::store(const uint64_t key, const Buffer &buf)
+{
+    if (capacity == 0)
+    {
+        return;
+    }
+
+    if (const auto it = index.find(key); it != index.end())
+    {
+        counts.bytes -= footprint(*it->second);
+        entries.erase(it->second);
+        index.erase(it);
+        counts.frames--;
+    }
+
+    blank.resize(buf.cells.size(), Cell::blank);
+    Entry entry{key, Animation::encode(blank, buf.cells)};
+
+    const size_t size = footprint(entry);
+    if (size > capacity)
+    {
+        return;
+    }
+
+    // oldest frames make room
+    while (counts.bytes + size > capacity)
+    {
+        counts.bytes -= footprint(entries.back());
+        index.erase(entries.back().key);
+        entries.pop_back();
+        counts.frames--;
+    }
+
+    entries.push_front(std::move(entry));
+    index[key] = entries.begin();
+    counts.bytes += size;
+    counts.frames++;
+}
+
+void FrameCache::clear()
+{
+    entries.clear();
+    index.clear();
+    counts.frames = 0;
+    counts.bytes = 0;
+}
+
+size_t FrameCache::footprint(const Entry &entry)
+{
+    // list node and index slot besides encoded cells
+    return sizeof(Entry) + entry.cells.capacity() + 4 * sizeof(void *) + sizeof(uint64_t);
+}
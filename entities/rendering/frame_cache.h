@@ -0,0 +1,57 @@
+/*
+ * frame_cache.h
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "buffer.h"
+#include "entities/view/camera.h"
+
+// lookups of frame cache
+class FrameCacheStats {
+public:
+    size_t hits = 0;
+    size_t misses = 0;
+    size_t frames = 0;  // frames held
+    size_t bytes = 0;   // memory of held frames
+};
+
+// finished frames of camera states seen before, camera moves in fixed steps so states repeat while orbiting
+// cells are stored run-length encoded, least recently used frames are dropped past memory limit
+class FrameCache {
+public:
+    explicit FrameCache(size_t capacity);   // bytes, 0 disables cache
+
+    // camera quantized to its steps and screen size, same key renders same frame of same object
+    [[nodiscard]] static uint64_t key(const Camera &cam, const Buffer &buf);
+
+    // copies cached cells into buffer, depth plane is left as it is
+    bool find(uint64_t key, Buffer &buf);
+    void store(uint64_t key, const Buffer &buf);
+
+    // object changed, every frame is stale
+    void clear();
+
+    [[nodiscard]] const FrameCacheStats &stats() const { return counts; }
+
+private:
+    class Entry {
+    public:
+        uint64_t key;
+        std::string cells;  // changes against blank screen
+    };
+
+    size_t capacity;
+    std::list<Entry> entries;   // most recently used first
+    std::unordered_map<uint64_t, std::list<Entry>::iterator> index;
+    std::vector<uint16_t> blank;
+    FrameCacheStats counts;
+
+    [[nodiscard]] static size_t footprint(const Entry &entry);
+};
@@ -0,0 +1,272 @@
+/*
+ * output.cpp
+ */
+
+#include "output.h"
+
+#include <cerrno>
+#include <climits>
+#include <fstream>
+#include <unistd.h>
+
+#include "config.h"
+
+// helper functions
+
+// bytes and write syscalls of calling thread so far, zero where /proc is missing
+static OutputStats thread_io()
+{
+    OutputStats io;
+    std::ifstream file("/proc/thread-self/io");
+    std::string key;
+    size_t value = 0;
+
+    while (file >> key >> value)
+    {
+        if (key == "wchar:")
+            io.bytes = value;
+        else if (key == "syscw:")
+            io.writes = value;
+    }
+
+    return io;
+}
+
+// writes all bytes, false on error
+static bool write_all(const int fd, const std::string &bytes, OutputStats &stats)
+{
+    stats = {};
+
+    while (stats.bytes < bytes.size())
+    {
+        const ssize_t n = ::write(fd, bytes.data() + stats.bytes, bytes.size() - stats.bytes);
+        stats.writes++;
+
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+
+            return false;
+        }
+
+        stats.bytes += static_cast<size_t>(n);
+    }
+
+    return true;
+}
+
+// cells of frame with overlay text over top rows
+static void compose(const Buffer &buf, const std::vector<std::string> &overlay, std::vector<uint16_t> &frame)
+{
+    frame.assign(buf.cells.begin(), buf.cells.end());
+
+    for (size_t row = 0; row < overlay.size() && row < buf.y; row++)
+    {
+        for (size_t col = 0; col < overlay[row].size() && col < buf.x; col++)
+        {
+            frame[row * buf.x + col] = Cell::pack(overlay[row][col], -1);
+        }
+    }
+}
+
+// 24-bit foreground color of material
+static std::string true_color(const Vec3 &diffuse)
+{
+    const auto channel = [](const float v) { return std::to_string(static_cast<int>(std::clamp(v, 0.0f, 1.0f) * 255.0f + 0.5f)); };
+    return "\x1b[38;2;" + channel(diffuse.x) + ';' + channel(diffuse.y) + ';' + channel(diffuse.z) + 'm';
+}
+
+// CursesOutput methods
+
+void CursesOutput::present(const Buffer &buf, const std::vector<std::string> &overlay)
+{
+    const OutputStats before = thread_io();
+
+    buf.printw();
+
+    for (size_t row = 0; row < overlay.size(); row++)
+    {
+        mvaddstr(static_cast<int>(row), 0, overlay[row].c_str());
+    }
+
+    refresh();
+
+    const OutputStats after = thread_io();
+    last.bytes = after.bytes - before.bytes;
+    last.writes = after.writes - before.writes;
+}
+
+// TerminalOutput methods
+
+TerminalOutput::TerminalOutput(const int fd, const std::vector<Material> *materials) : fd(fd), materials(materials) {}
+
+TerminalOutput::~TerminalOutput()
+{
+    // attributes back to default, curses does not know they were changed
+    bytes = "\x1b[m";
+    flush();
+}
+
+void TerminalOutput::present(const Buffer &buf, const std::vector<std::string> &overlay)
+{
+    // nothing on terminal can be reused after resize
+    if (buf.x != width || buf.y != height)
+    {
+        width = buf.x;
+        height = buf.y;
+        previous.clear();
+    }
+
+    // unknown screen is cleared, then it is diffed like any other
+    bytes.clear();
+
+    if (previous.empty())
+    {
+        bytes += "\x1b[39;49m\x1b[2J";
+        slot = 0;
+        previous.assign(static_cast<size_t>(width) * height, Cell::blank);
+    }
+
+    compose(buf, overlay, frame);
+
+    cursor_row = UINT_MAX;
+
+    for (unsigned int row = 0; row < height; row++)
+    {
+        const uint16_t *const cells = &frame[static_cast<size_t>(row) * width];
+        const uint16_t *const shown = &previous[static_cast<size_t>(row) * width];
+
+        for (unsigned int col = 0; col < width; col++)
+        {
+            if (cells[col] == shown[col])
+            {
+                continue;
+            }
+
+            // short gaps of unchanged cells are written again, cheaper than moving cursor over them
+            if (row == cursor_row && col >= cursor_col && col - cursor_col <= TERMINAL_SKIP_CELLS)
+            {
+                while (cursor_col < col)
+                {
+                    put(cells[cursor_col]);
+                }
+            }
+            else
+            {
+                move(row, col);
+            }
+
+            put(cells[col]);
+        }
+    }
+
+    flush();
+    previous.swap(frame);
+}
+
+void TerminalOutput::invalidate()
+{
+    // curses repaints its own blank screen after resize, before frame is written over it
+    refresh();
+    previous.clear();
+}
+
+void TerminalOutput::move(const unsigned int row, const unsigned int col)
+{
+    bytes += "\x1b[" + std::to_string(row + 1) + ';' + std::to_string(col + 1) + 'H';
+    cursor_row = row;
+    cursor_col = col;
+}
+
+void TerminalOutput::put(const uint16_t cell)
+{
+    int color = Cell::slot(cell);
+    if (materials ? color > static_cast<int>(materials->size()) : color >= COLORS || color >= COLOR_PAIRS)
+    {
+        color = 0;
+    }
+
+    if (color != slot)
+    {
+        if (color == 0)
+            bytes += "\x1b[39;49m";
+        else if (materials)
+            bytes += true_color((*materials)[color - 1].diffuse);
+        else
+            bytes += "\x1b[38;5;" + std::to_string(color) + ";40m";    // same pairs as curses, material on black
+
+        slot = color;
+    }
+
+    bytes += Cell::glyph(cell);
+    cursor_col++;
+}
+
+void TerminalOutput::flush()
+{
+    // terminal state is unknown after failed write, frame becomes previous one
+    if (!write_all(fd, bytes, last))
+    {
+        frame.clear();
+    }
+}
+
+// TextOutput methods
+
+TextOutput::TextOutput(const int fd, const std::vector<Material> *materials) : fd(fd), materials(materials) {}
+
+void TextOutput::present(const Buffer &buf, const std::vector<std::string> &overlay)
+{
+    std::vector<uint16_t> frame;
+    compose(buf, overlay, frame);
+
+    bytes.clear();
+
+    for (unsigned int row = 0; row < buf.y; row++)
+    {
+        const uint16_t *const cells = &frame[static_cast<size_t>(row) * buf.x];
+
+        unsigned int end = buf.x;
+        while (end > 0 && Cell::glyph(cells[end - 1]) == ' ')
+        {
+            end--;
+        }
+
+        int color = 0;  // material slot of current color, every line starts uncolored
+
+        for (unsigned int col = 0; col < end; col++)
+        {
+            int slot = Cell::slot(cells[col]);
+            if (!materials || slot > static_cast<int>(materials->size()))
+            {
+                slot = 0;
+            }
+
+            if (slot != color)
+            {
+                if (slot)
+                {
+                    bytes += true_color((*materials)[slot - 1].diffuse);
+                }
+                else
+                {
+                    bytes += "\x1b[39m";
+                }
+
+                color = slot;
+            }
+
+            bytes += Cell::glyph(cells[col]);
+        }
+
+        if (color)
+        {
+            bytes += "\x1b[39m";
+        }
+
+        bytes += '\n';
+    }
+
+    error = !write_all(fd, bytes, last);
+}
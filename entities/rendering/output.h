@@ -0,0 +1,91 @@
+/*
+ * output.h
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "buffer.h"
+#include "entities/geometry/object.h"
+
+// bytes sent to terminal for one frame
+class OutputStats {
+public:
+    size_t bytes = 0;
+    size_t writes = 0;  // write syscalls
+};
+
+// shows finished frames on terminal
+class Output {
+public:
+    virtual ~Output() = default;
+
+    // frame with lines of text over its top rows
+    virtual void present(const Buffer &buf, const std::vector<std::string> &overlay) = 0;
+
+    // next frame is drawn whole, screen contents are unknown
+    virtual void invalidate() {}
+
+    // traffic of last frame
+    [[nodiscard]] const OutputStats &stats() const { return last; }
+
+protected:
+    OutputStats last;
+};
+
+// ncurses screen, diffed by curses on refresh
+class CursesOutput : public Output {
+public:
+    void present(const Buffer &buf, const std::vector<std::string> &overlay) override;
+};
+
+// escape sequences written straight to terminal, only cells changed since previous frame
+// colors follow curses pairs, so curses is still used for palette and input,
+// or materials as 24-bit colors when given, then curses is not needed at all
+class TerminalOutput : public Output {
+public:
+    explicit TerminalOutput(int fd, const std::vector<Material> *materials = nullptr);
+    ~TerminalOutput() override;
+
+    TerminalOutput(const TerminalOutput &) = delete;
+    TerminalOutput &operator=(const TerminalOutput &) = delete;
+
+    void present(const Buffer &buf, const std::vector<std::string> &overlay) override;
+    void invalidate() override;
+
+private:
+    int fd;
+    const std::vector<Material> *materials;
+    unsigned int width = 0, height = 0;
+    std::vector<uint16_t> frame;        // cells with overlay
+    std::vector<uint16_t> previous;     // cells on terminal, empty if unknown
+    std::string bytes;                  // escape sequences of frame, reused
+
+    int slot = 0;                                   // color pair terminal draws with
+    unsigned int cursor_row = 0, cursor_col = 0;    // where next character goes, row past screen if unknown
+
+    void move(unsigned int row, unsigned int col);
+    void put(uint16_t cell);
+    void flush();
+};
+
+// frames as lines of text for files and pipes, no terminal needed
+// trailing blanks of rows are dropped, materials are 24-bit colors when given
+class TextOutput : public Output {
+public:
+    TextOutput(int fd, const std::vector<Material> *materials);
+
+    void present(const Buffer &buf, const std::vector<std::string> &overlay) override;
+
+    [[nodiscard]] bool failed() const { return error; }
+
+private:
+    int fd;
+    const std::vector<Material> *materials;
+    std::string bytes;
+    bool error = false;
+};
+
@@ -0,0 +1,135 @@
+/*
+ * rasterizer.cpp
+ */
+
+#include "rasterizer.h"
+
+#include <algorithm>
+
+#include "config.h"
+
+static_assert(RASTER_TILE_WIDTH % DEPTH_TILE_WIDTH == 0 && RASTER_TILE_HEIGHT % DEPTH_TILE_HEIGHT == 0, "hierarchical depth tiles must not cross raster tiles");
+
+TileRasterizer::TileRasterizer(const unsigned int threads) : pool(threads) {}
+
+void TileRasterizer::add(const Buffer &buf, const Projection &projection, const char c, const int material)
+{
+    if (const auto triangle = buf.setup(projection))
+    {
+        triangles.push_back({*triangle, c, material});
+    }
+}
+
+void TileRasterizer::sort()
+{
+    // bucket sort by nearest vertex, stable so equal depths keep submission order
+    float z_min = std::numeric_limits<float>::max();
+    float z_max = -std::numeric_limits<float>::max();
+
+    for (const auto &t : triangles)
+    {
+        z_min = std::min(z_min, t.triangle.z_min);
+        z_max = std::max(z_max, t.triangle.z_min);
+    }
+
+    const float scale = z_max > z_min ? static_cast<float>(DEPTH_BUCKETS - 1) / (z_max - z_min) : 0.0f;
+    const auto bucket = [&](const RasterTriangle &t) {
+        return std::min(static_cast<size_t>((t.triangle.z_min - z_min) * scale), DEPTH_BUCKETS - 1);
+    };
+
+    buckets.assign(DEPTH_BUCKETS + 1, 0);
+    for (const auto &t : triangles)
+    {
+        buckets[bucket(t) + 1]++;
+    }
+
+    for (size_t i = 1; i <= DEPTH_BUCKETS; i++)
+    {
+        buckets[i] += buckets[i - 1];
+    }
+
+    // moved rather than indexed, so drawing reads them in sequence
+    sorted.resize(triangles.size());
+    for (const auto &t : triangles)
+    {
+        sorted[buckets[bucket(t)]++] = t;
+    }
+
+    std::swap(triangles, sorted);
+}
+
+void TileRasterizer::draw(Buffer &buf)
+{
+    sort();
+
+    last = {};
+    last.triangles = triangles.size();
+
+    const PixelRect screen {0, 0, static_cast<int>(buf.x) - 1, static_cast<int>(buf.y) - 1};
+
+    if (pool.size() <= 1)
+    {
+        for (const auto &t : triangles)
+        {
+            buf.draw_triangle(t.triangle, t.c, t.material, screen, last);
+        }
+
+        last.covered = buf.covered(screen);
+        triangles.clear();
+        return;
+    }
+
+    const int tiles_x = (static_cast<int>(buf.x) + RASTER_TILE_WIDTH - 1) / RASTER_TILE_WIDTH;
+    const int tiles_y = (static_cast<int>(buf.y) + RASTER_TILE_HEIGHT - 1) / RASTER_TILE_HEIGHT;
+
+    bins.resize(static_cast<size_t>(tiles_x * tiles_y));
+    for (auto &bin : bins)
+    {
+        bin.clear();
+    }
+
+    // binning in sorted order keeps depth ties resolved as in serial drawing
+    for (size_t i = 0; i < triangles.size(); i++)
+    {
+        const PixelRect &rect = triangles[i].triangle.bounds;
+
+        for (int ty = rect.y0 / RASTER_TILE_HEIGHT; ty <= rect.y1 / RASTER_TILE_HEIGHT; ty++)
+        {
+            for (int tx = rect.x0 / RASTER_TILE_WIDTH; tx <= rect.x1 / RASTER_TILE_WIDTH; tx++)
+            {
+                bins[ty * tiles_x + tx].push_back(static_cast<uint32_t>(i));
+            }
+        }
+    }
+
+    tile_stats.assign(bins.size(), {});
+
+    // tiles own disjoint cells and depth tiles, no locking while drawing
+    pool.run(bins.size(), [this, &buf, tiles_x](const size_t tile) {
+        const int tx = static_cast<int>(tile) % tiles_x;
+        const int ty = static_cast<int>(tile) / tiles_x;
+
+        const PixelRect clip {
+            tx * RASTER_TILE_WIDTH,
+            ty * RASTER_TILE_HEIGHT,
+            std::min((tx + 1) * RASTER_TILE_WIDTH, static_cast<int>(buf.x)) - 1,
+            std::min((ty + 1) * RASTER_TILE_HEIGHT, static_cast<int>(buf.y)) - 1
+        };
+
+        RasterStats &stats = tile_stats[tile];
+        for (const uint32_t i : bins[tile])
+        {
+            const RasterTriangle &t = triangles[i];
+            buf.draw_triangle(t.triangle, t.c, t.material, clip, stats);
+        }
+
+        stats.covered = buf.covered(clip);
+    });
+
+    for (const auto &stats : tile_stats)
+    {
+        last += stats;
+    }
+
+    triangles.clear();
+}
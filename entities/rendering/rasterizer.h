@@ -0,0 +1,47 @@
+/*
+ * rasterizer.h
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "buffer.h"
+#include "utils/thread_pool.h"
+
+// projected triangle waiting for rasterization
+class RasterTriangle {
+public:
+    TriangleSetup triangle;
+    char c;
+    int material;
+};
+
+// collects triangles of frame and draws them front to back, screen tiles in parallel when there are more threads
+// output is the same for any number of threads
+class TileRasterizer {
+public:
+    explicit TileRasterizer(unsigned int threads);  // 0 - all cores
+
+    [[nodiscard]] unsigned int threads() const { return pool.size(); }
+
+    void add(const Buffer &buf, const Projection &projection, char c, int material);   // off screen ones are dropped
+
+    // draws collected triangles sorted by nearest depth, list is emptied
+    void draw(Buffer &buf);
+
+    // work done by last draw
+    [[nodiscard]] const RasterStats &stats() const { return last; }
+
+private:
+    ThreadPool pool;
+    std::vector<RasterTriangle> triangles;      // front to back after sorting
+    std::vector<RasterTriangle> sorted;         // scratch of sorting
+    std::vector<uint32_t> buckets;              // triangles per depth slice, then first position of slice
+    std::vector<std::vector<uint32_t>> bins;    // triangles of every tile
+    std::vector<RasterStats> tile_stats;
+    RasterStats last;
+
+    void sort();
+};
@@ -4,6 +4,170 @@
 
 #include "renderer.h"
 
+#include <algorithm>
+#include <chrono>
+#include <type_traits>
+
+// helper functions
+
+// calls draw with index, vertex indices and material (-1 for none) of every face
+template<typename Draw>
+static void for_each_face(const std::vector<Face> &faces, const Draw &draw)
+{
+    for (size_t i = 0; i < faces.size(); i++)
+    {
+        const Face &face = faces[i];
+        draw(i, face.indices[0], face.indices[1], face.indices[2], face.material ? *face.material : -1);
+    }
+}
+
+template<typename Draw>
+static void for_each_face(const PackedMesh &mesh, const Draw &draw)
+{
+    const uint32_t *idx = mesh.indices.data();
+
+    for (const auto &run : mesh.runs)
+    {
+        const size_t end = run.first + run.count;
+        for (size_t i = run.first; i < end; i++)
+        {
+            const uint32_t *f = idx + 3 * i;
+            draw(i, f[0], f[1], f[2], run.material);
+        }
+    }
+}
+
+// screen interval of node bounds along one row of affine transform, widened against rounding
+static void node_interval(const BvhNode &node, const float *row, float &low, float &high)
+{
+    const Vec3 center = (node.min + node.max) * 0.5f;
+    const Vec3 half = (node.max - node.min) * 0.5f;
+
+    const float c = row[0] * center.x + row[1] * center.y + row[2] * center.z + row[3];
+    const float e = std::fabs(row[0]) * half.x + std::fabs(row[1]) * half.y + std::fabs(row[2]) * half.z;
+    const float margin = (std::fabs(c) + e) * 1e-5f;
+
+    low = c - e - margin;
+    high = c + e + margin;
+}
+
+// screen bounds of boxes of hierarchy roots, contain screen bounds of mesh
+static ScreenBounds root_bounds(const PackedMesh &mesh, const VertexTransform &transform)
+{
+    ScreenBounds bounds;
+
+    for (const uint32_t root : mesh.bvh.roots)
+    {
+        float x0, x1, y0, y1;
+        node_interval(mesh.bvh.nodes[root], &transform.matrix.m[0], x0, x1);
+        node_interval(mesh.bvh.nodes[root], &transform.matrix.m[4], y0, y1);
+        bounds.add(x0, y0);
+        bounds.add(x1, y1);
+    }
+
+    return bounds;
+}
+
+// screen bounds of corners of all faces, every side is found by best first search through hierarchy,
+// so only few leaves near silhouette are transformed
+template<typename Positions>
+static ScreenBounds hierarchy_bounds(const PackedMesh &mesh, const Positions &vertices, const VertexTransform &transform)
+{
+    const FaceBvh &bvh = mesh.bvh;
+    const uint32_t *idx = mesh.indices.data();
+    ScreenBounds bounds;
+
+    // bound of node on side, larger is further out, sides are min x, max x, min y, max y
+    const auto reach = [&](const uint32_t index, const int side) {
+        float low, high;
+        node_interval(bvh.nodes[index], &transform.matrix.m[side < 2 ? 0 : 4], low, high);
+        return side % 2 ? high : -low;
+    };
+
+    const auto found = [&](const int side) {
+        const float values[4] = {-bounds.min_x, bounds.max_x, -bounds.min_y, bounds.max_y};
+        return values[side];
+    };
+
+    std::vector<std::pair<float, uint32_t>> heap;
+
+    for (int side = 0; side < 4; side++)
+    {
+        heap.clear();
+        for (const uint32_t root : bvh.roots)
+        {
+            heap.emplace_back(reach(root, side), root);
+        }
+        std::ranges::make_heap(heap);
+
+        while (!heap.empty() && heap.front().first > found(side))
+        {
+            const uint32_t index = heap.front().second;
+            const BvhNode &node = bvh.nodes[index];
+            std::ranges::pop_heap(heap);
+            heap.pop_back();
+
+            if (!node.leaf())
+            {
+                for (const uint32_t child : {index + 1, node.first})
+                {
+                    heap.emplace_back(reach(child, side), child);
+                    std::ranges::push_heap(heap);
+                }
+                continue;
+            }
+
+            for (size_t i = 3 * node.first; i < 3 * (node.first + node.count); i++)
+            {
+                const Vec3 sv = transform.to_screen(vertices[idx[i]]);
+                bounds.add(sv.x, sv.y);
+            }
+        }
+    }
+
+    return bounds;
+}
+
+// calls draw for faces of leaves whose screen bounds intersect view
+template<typename Draw>
+static void for_each_visible_face(const PackedMesh &mesh, const VertexTransform &transform, const float logical_x, const float logical_y, const Draw &draw)
+{
+    const FaceBvh &bvh = mesh.bvh;
+    const uint32_t *idx = mesh.indices.data();
+    std::vector<uint32_t> stack(bvh.roots.rbegin(), bvh.roots.rend());
+
+    while (!stack.empty())
+    {
+        const uint32_t index = stack.back();
+        const BvhNode &node = bvh.nodes[index];
+        stack.pop_back();
+
+        float x0, x1, y0, y1;
+        node_interval(node, &transform.matrix.m[0], x0, x1);
+        node_interval(node, &transform.matrix.m[4], y0, y1);
+
+        if (x1 < 0.0f || x0 > logical_x || y1 < 0.0f || y0 > logical_y)
+        {
+            continue;
+        }
+
+        if (!node.leaf())
+        {
+            stack.push_back(node.first);
+            stack.push_back(index + 1);
+            continue;
+        }
+
+        for (size_t i = node.first; i < node.first + node.count; i++)
+        {
+            const uint32_t *f = idx + 3 * i;
+            draw(i, f[0], f[1], f[2], node.material);
+        }
+    }
+}
+
+// methods
+
 char Renderer::luminance_char(const Vec3 &normal, const Vec3 &light, const std::string &scale)
 {
     const float sim = (Vec3::cosine_similarity(normal, light) + 1.0f) * 0.5f;
@@ -11,81 +175,236 @@ char Renderer::luminance_char(const Vec3 &normal, const Vec3 &light, const std::
     return scale[idx];
 }
 
-void Renderer::render(Buffer &buf, const Object &obj, const Camera &cam, const Light  &light, bool static_light, bool color_support)
+size_t Renderer::select_level(const Object &obj, const Buffer &buf, const Camera &cam)
 {
-    const float az_cos = std::cos(cam.azimuth);
-    const float az_sin = std::sin(cam.azimuth);
-    const float al_cos = std::cos(cam.altitude);
-    const float al_sin = std::sin(cam.altitude);
-
-    // pre-computed rotations
-    auto rot_y = [az_cos, az_sin](const Vec3 &v) {
-        return Vec3::rotate_y(v, std::atan2(-az_sin, az_cos));
-    };
+    // cell size in object units, to_screen scales by half of zoom
+    const float cell = std::min(buf.dx, buf.dy) * 2.0f / cam.zoom;
 
-    auto rot_x = [al_cos, al_sin](const Vec3 &v) {
-        return Vec3::rotate_x(v, std::atan2(-al_sin, al_cos));
+    size_t level = 0;
+    while (level < obj.levels.size() && obj.levels[level].error < cell)
+    {
+        level++;
+    }
+
+    return level;
+}
+
+template<typename Positions, typename Faces>
+void Renderer::render_mesh(Buffer &buf, const Positions &vertices, const Faces &faces, const Camera &cam, const Light &light, bool static_light, bool color_support, TileRasterizer *rasterizer, RenderTimings *timings)
+{
+    if (vertices.size() == 0)
+    {
+        return; // nothing loaded yet
+    }
+
+    // stage took time since previous lap, clock is read only when timings are wanted
+    using Clock = std::chrono::steady_clock;
+    Clock::time_point mark = timings ? Clock::now() : Clock::time_point();
+    const auto lap = [&](double RenderTimings::*stage) {
+        if (timings)
+        {
+            const Clock::time_point now = Clock::now();
+            timings->*stage = std::chrono::duration<double, std::milli>(now - mark).count();
+            mark = now;
+        }
     };
 
     const float lx = buf.logical_x;
     const float ly = buf.logical_y;
 
-    // first pass - rotate, project, collect bounds
-    const size_t vcount = obj.vertices.size();
+    VertexTransform transform = VertexTransform::orbit(cam, lx, ly);
+    constexpr bool planar = std::is_same_v<Positions, PlanarPositions>;
+    constexpr bool packed = std::is_same_v<Faces, PackedMesh>;
 
-    std::vector<Vec3> rverts(vcount);   // rotated vertices
-    std::vector<Vec3> sverts(vcount);   // screen coords (without offset)
+    // meshes with hierarchy are centered by bounds of face corners before any vertex is transformed, so offset is
+    // part of matrix in both modes, zoomed in past screen only faces of hierarchy leaves in view are drawn once enough
+    // of mesh box is out and their corners are transformed as faces are drawn
+    bool cull = false;
 
-    float min_x = std::numeric_limits<float>::max();
-    float max_x = -std::numeric_limits<float>::max();
-    float min_y = std::numeric_limits<float>::max();
-    float max_y = -std::numeric_limits<float>::max();
-
-    for (size_t i = 0; i < vcount; i++)
+    if constexpr (packed)
     {
-        const Vec3 rv = rot_x(rot_y(obj.vertices[i]));
-        rverts[i] = rv;
+        if (faces.face_count() == 0)
+        {
+            return;
+        }
 
-        const Vec3 sv = Vec3::to_screen(rv, cam.zoom, lx, ly);
-        sverts[i] = sv;
+        transform.center(hierarchy_bounds(faces, vertices, transform), lx, ly);
 
-        min_x = std::min(min_x, sv.x);
-        max_x = std::max(max_x, sv.x);
-        min_y = std::min(min_y, sv.y);
-        max_y = std::max(max_y, sv.y);
+        const ScreenBounds box = root_bounds(faces, transform);
+        const float width = box.max_x - box.min_x;
+        const float height = box.max_y - box.min_y;
+        cull = std::min(width, lx) * std::min(height, ly) < BVH_CULL_VIEW * width * height;
     }
 
-    // offset that centers the bounding box in logical space
-    const float off_x = (lx - (max_x - min_x)) * 0.5f - min_x;
-    const float off_y = (ly - (max_y - min_y)) * 0.5f - min_y;
-    const Vec3 offset(off_x, off_y, 0.0f);
+    // first pass - screen coords of all vertices unless faces are culled, rotated vertices only without precomputed
+    // normals
+    PlanarPositions rverts;
+    PlanarPositions sverts;
+    ScreenBounds bounds;
 
-    // second pass - draw faces
-    for (const auto &face : obj.faces)
+    if (!cull)
+    {
+        if constexpr (planar)
+        {
+            bounds = transform.apply(vertices, packed ? nullptr : &rverts, sverts);
+        }
+        else
+        {
+            // vertices while loading or quantized positions, decoded one at a time
+            const size_t vcount = vertices.size();
+            for (auto *p : {&rverts, &sverts})
+            {
+                if (packed && p == &rverts)
+                {
+                    continue;
+                }
+
+                p->x.resize(vcount);
+                p->y.resize(vcount);
+                p->z.resize(vcount);
+            }
+
+            for (size_t i = 0; i < vcount; i++)
+            {
+                const Vec3 v = vertices[i];
+                const Vec3 sv = transform.to_screen(v);
+
+                if constexpr (!packed)
+                {
+                    const Vec3 rv = transform.rotate(v);
+                    rverts.x[i] = rv.x;
+                    rverts.y[i] = rv.y;
+                    rverts.z[i] = rv.z;
+                }
+
+                sverts.x[i] = sv.x;
+                sverts.y[i] = sv.y;
+                sverts.z[i] = sv.z;
+                bounds.add(sv.x, sv.y);
+            }
+        }
+    }
+
+    // meshes without hierarchy have no bounds before the pass, their screen coords are moved after it
+    if constexpr (!packed)
     {
-        const Vec3 &rv1 = rverts[face.indices[0]];
-        const Vec3 &rv2 = rverts[face.indices[1]];
-        const Vec3 &rv3 = rverts[face.indices[2]];
+        const Vec3 offset = transform.center(bounds, lx, ly);
+        for (size_t i = 0; i < sverts.size(); i++)
+        {
+            sverts.x[i] += offset.x;
+            sverts.y[i] += offset.y;
+        }
+    }
 
+    lap(&RenderTimings::vertex_ms);
+
+    const auto corner = [&](const unsigned int i) {
+        return cull ? transform.to_screen(vertices[i]) : sverts[i];
+    };
+
+    // second pass - draw faces
+    const auto draw = [&](const size_t face, const unsigned int i1, const unsigned int i2, const unsigned int i3, const int material) {
         // back-face culling in camera space
-        Vec3 normal_cam = Vec3::cross(rv2 - rv1, rv3 - rv1).normalize();
+        Vec3 normal_cam;
+        if constexpr (packed)
+        {
+            normal_cam = transform.rotate(faces.normals[face]);
+        }
+        else
+        {
+            const Vec3 rv1 = rverts[i1];
+            normal_cam = Vec3::cross(rverts[i2] - rv1, rverts[i3] - rv1).normalize();
+        }
 
         if (normal_cam.z >= 0.0f)
         {
-            continue;
+            return;
         }
 
-        const Vec3 normal_view = -normal_cam;
+        const Vec3 s1 = corner(i1);
+        const Vec3 s2 = corner(i2);
+        const Vec3 s3 = corner(i3);
 
-        // screen coordinates with centering offset
-        const Vec3 s1 = sverts[face.indices[0]] + offset;
-        const Vec3 s2 = sverts[face.indices[1]] + offset;
-        const Vec3 s3 = sverts[face.indices[2]] + offset;
+        // shading, file normals replace winding ones when present
+        Vec3 n_light;
+        if constexpr (packed)
+        {
+            const Vec3 &n = faces.shading.empty() ? faces.normals[face] : faces.shading[face];
+            n_light = static_light ? n : -(faces.shading.empty() ? normal_cam : transform.rotate(n));
+        }
+        else
+        {
+            n_light = static_light ? Vec3::cross(vertices[i2] - vertices[i1], vertices[i3] - vertices[i1]).normalize() : -normal_cam;
+        }
 
-        // shading
-        const Vec3 n_light = static_light ? Vec3::cross(obj.vertices[face.indices[1]] - obj.vertices[face.indices[0]], obj.vertices[face.indices[2]] - obj.vertices[face.indices[0]]).normalize() : normal_view;
         const char lum = luminance_char(n_light, light.direction, CHARS_LUM);
 
-        buf.draw_projection(Projection(s1, s2, s3, lum), lum, (color_support && face.material) ? *face.material : -1);
+        if (rasterizer)
+        {
+            rasterizer->add(buf, Projection(s1, s2, s3, lum), lum, color_support ? material : -1);
+        }
+        else
+        {
+            buf.draw_projection(Projection(s1, s2, s3, lum), lum, color_support ? material : -1);
+        }
+    };
+
+    if constexpr (packed)
+    {
+        if (cull)
+        {
+            for_each_visible_face(faces, transform, lx, ly, draw);
+        }
+        else
+        {
+            for_each_face(faces, draw);
+        }
+    }
+    else
+    {
+        for_each_face(faces, draw);
+    }
+
+    lap(&RenderTimings::face_ms);
+
+    if (rasterizer)
+    {
+        rasterizer->draw(buf);
+    }
+
+    lap(&RenderTimings::raster_ms);
+}
+
+void Renderer::render(Buffer &buf, const Object &obj, const Camera &cam, const Light  &light, bool static_light, bool color_support, size_t level, TileRasterizer *rasterizer, RenderTimings *timings)
+{
+    if (timings)
+    {
+        *timings = {};
+    }
+
+    const bool full = level == 0 || level > obj.levels.size();
+    const auto &vertices = full ? obj.vertices : obj.levels[level - 1].vertices;
+    const auto &compact = full ? obj.compact : obj.levels[level - 1].compact;
+    const auto &faces = full ? obj.faces : obj.levels[level - 1].faces;
+    const auto &packed = full ? obj.packed : obj.levels[level - 1].packed;
+
+    if (packed)
+    {
+        if (compact)
+        {
+            render_mesh(buf, *compact, *packed, cam, light, static_light, color_support, rasterizer, timings);
+        }
+        else
+        {
+            render_mesh(buf, packed->positions, *packed, cam, light, static_light, color_support, rasterizer, timings);
+        }
+    }
+    else if (compact)
+    {
+        render_mesh(buf, *compact, faces, cam, light, static_light, color_support, rasterizer, timings);
+    }
+    else
+    {
+        render_mesh(buf, vertices, faces, cam, light, static_light, color_support, rasterizer, timings);
     }
 }
\ No newline at end of file
@@ -5,18 +5,36 @@
 #pragma once
 
 #include "buffer.h"
+#include "rasterizer.h"
+#include "transform.h"
 #include "entities/geometry/object.h"
 #include "entities/view/camera.h"
 #include "entities/view/light.h"
 #include "utils/algorithms.h"
 #include "config.h"
 
+// time spent in stages of one render
+class RenderTimings {
+public:
+    double vertex_ms = 0.0;     // screen coords of vertices, or bounds from hierarchy when faces are culled
+    double face_ms = 0.0;       // culling, shading and setup of faces
+    double raster_ms = 0.0;     // drawing triangles collected by rasterizer
+};
+
 class Renderer {
 public:
-    // renders object into buffer with given view parameters
-    static void render(Buffer &buf, const Object &obj, const Camera &cam, const Light  &light, bool static_light, bool color_support) ;
+    // renders object into buffer with given view parameters, level 0 is full mesh, n is obj.levels[n - 1]
+    // triangles go through rasterizer if given, otherwise they are drawn one by one, stages are timed if timings given
+    static void render(Buffer &buf, const Object &obj, const Camera &cam, const Light  &light, bool static_light, bool color_support, size_t level = 0, TileRasterizer *rasterizer = nullptr, RenderTimings *timings = nullptr);
+
+    // coarsest level whose error projects below one character cell
+    static size_t select_level(const Object &obj, const Buffer &buf, const Camera &cam);
 
 private:
+    // renders one mesh, positions are vertices, planar or quantized, faces are list or packed
+    template<typename Positions, typename Faces>
+    static void render_mesh(Buffer &buf, const Positions &vertices, const Faces &faces, const Camera &cam, const Light &light, bool static_light, bool color_support, TileRasterizer *rasterizer, RenderTimings *timings);
+
     // returns luminance character based on angle between normal and light
     static char luminance_char(const Vec3 &normal, const Vec3 &light, const std::string &scale = CHARS_LUM);
 };
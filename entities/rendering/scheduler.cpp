@@ -0,0 +1,51 @@
+/*
+ * scheduler.cpp
+ */
+
+#include "scheduler.h"
+
+#include <algorithm>
+
+void FrameScheduler::animate(const Clock::duration interval, const Clock::time_point now)
+{
+    if (period == interval)
+    {
+        return;
+    }
+
+    period = interval;
+    next_tick = now + interval;
+}
+
+bool FrameScheduler::tick(const Clock::time_point now)
+{
+    if (!period || now < next_tick)
+    {
+        return false;
+    }
+
+    // missed steps are dropped, not replayed
+    next_tick += *period;
+    if (next_tick <= now)
+    {
+        next_tick = now + *period;
+    }
+
+    return true;
+}
+
+int FrameScheduler::wait_ms(const Clock::time_point now) const
+{
+    if (dirty)
+    {
+        return 0;
+    }
+
+    if (!period)
+    {
+        return -1;
+    }
+
+    const auto left = std::chrono::ceil<std::chrono::milliseconds>(next_tick - now).count();
+    return static_cast<int>(std::max<decltype(left)>(left, 0));
+}
@@ -0,0 +1,36 @@
+/*
+ * scheduler.h
+ */
+
+#pragma once
+
+#include <chrono>
+#include <optional>
+
+// decides when frames are drawn, idle loop waits for input only
+class FrameScheduler {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    // view changed, draw next frame
+    void invalidate() { dirty = true; }
+
+    // wake up periodically for animations until stopped, replaces previous period
+    void animate(Clock::duration interval, Clock::time_point now = Clock::now());
+    void stop() { period.reset(); }
+
+    // animation step is due, next one is scheduled
+    bool tick(Clock::time_point now = Clock::now());
+
+    // frame has to be drawn
+    [[nodiscard]] bool due() const { return dirty; }
+    void drawn() { dirty = false; }
+
+    // milliseconds until next wake up, -1 to block on input
+    [[nodiscard]] int wait_ms(Clock::time_point now = Clock::now()) const;
+
+private:
+    bool dirty = true;
+    std::optional<Clock::duration> period;
+    Clock::time_point next_tick;
+};
@@ -0,0 +1,303 @@
+/*
+ * transform.cpp
+ */
+
+#include "transform.h"
+
+#include <cmath>
+#include <utility>
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#define TRANSFORM_X86
+#include <immintrin.h>
+#endif
+
+// planar arrays of one apply call
+class TransformArrays {
+public:
+    const float *x, *y, *z;
+    float *rx, *ry, *rz;    // null if rotated positions are not wanted
+    float *sx, *sy, *sz;
+};
+
+using TransformKernel = void (*)(const VertexTransform &t, const TransformArrays &a, size_t count, ScreenBounds &bounds);
+
+// helper functions
+
+// vertices from begin to end one at a time, also finishes tails of vector kernels
+static void transform_range(const VertexTransform &t, const TransformArrays &a, const size_t begin, const size_t end, ScreenBounds &bounds)
+{
+    for (size_t i = begin; i < end; i++)
+    {
+        const Vec3 v(a.x[i], a.y[i], a.z[i]);
+        const Vec3 s = t.to_screen(v);
+
+        if (a.rx)
+        {
+            const Vec3 r = t.rotate(v);
+            a.rx[i] = r.x;
+            a.ry[i] = r.y;
+            a.rz[i] = r.z;
+        }
+
+        a.sx[i] = s.x;
+        a.sy[i] = s.y;
+        a.sz[i] = s.z;
+
+        bounds.add(s.x, s.y);
+    }
+}
+
+static void transform_scalar(const VertexTransform &t, const TransformArrays &a, const size_t count, ScreenBounds &bounds)
+{
+    transform_range(t, a, 0, count, bounds);
+}
+
+#ifdef TRANSFORM_X86
+
+// vector kernels below differ only in width, mul and add are kept separate so every width rounds like scalar code
+
+__attribute__((target("sse2")))
+static void transform_sse2(const VertexTransform &t, const TransformArrays &a, const size_t count, ScreenBounds &bounds)
+{
+    const auto &m = t.matrix.m;
+    const auto &r = t.rotation.m;
+    __m128 min_x = _mm_set1_ps(bounds.min_x), max_x = _mm_set1_ps(bounds.max_x);
+    __m128 min_y = _mm_set1_ps(bounds.min_y), max_y = _mm_set1_ps(bounds.max_y);
+
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        const __m128 x = _mm_loadu_ps(a.x + i);
+        const __m128 y = _mm_loadu_ps(a.y + i);
+        const __m128 z = _mm_loadu_ps(a.z + i);
+
+        const __m128 sx = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(m[0]), x), _mm_mul_ps(_mm_set1_ps(m[1]), y)), _mm_mul_ps(_mm_set1_ps(m[2]), z)), _mm_set1_ps(m[3]));
+        const __m128 sy = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(m[4]), x), _mm_mul_ps(_mm_set1_ps(m[5]), y)), _mm_mul_ps(_mm_set1_ps(m[6]), z)), _mm_set1_ps(m[7]));
+
+        const __m128 sz = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(m[8]), x), _mm_mul_ps(_mm_set1_ps(m[9]), y)), _mm_mul_ps(_mm_set1_ps(m[10]), z)), _mm_set1_ps(m[11]));
+
+        _mm_storeu_ps(a.sx + i, sx);
+        _mm_storeu_ps(a.sy + i, sy);
+        _mm_storeu_ps(a.sz + i, sz);
+
+        if (a.rx)
+        {
+            _mm_storeu_ps(a.rx + i, _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(r[0]), x), _mm_mul_ps(_mm_set1_ps(r[1]), y)), _mm_mul_ps(_mm_set1_ps(r[2]), z)));
+            _mm_storeu_ps(a.ry + i, _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(r[3]), x), _mm_mul_ps(_mm_set1_ps(r[4]), y)), _mm_mul_ps(_mm_set1_ps(r[5]), z)));
+            _mm_storeu_ps(a.rz + i, _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(r[6]), x), _mm_mul_ps(_mm_set1_ps(r[7]), y)), _mm_mul_ps(_mm_set1_ps(r[8]), z)));
+        }
+
+        // accumulator second, nan coordinates are skipped like in scalar code
+        min_x = _mm_min_ps(sx, min_x);
+        max_x = _mm_max_ps(sx, max_x);
+        min_y = _mm_min_ps(sy, min_y);
+        max_y = _mm_max_ps(sy, max_y);
+    }
+
+    alignas(16) float lanes[4][4];
+    _mm_store_ps(lanes[0], min_x);
+    _mm_store_ps(lanes[1], max_x);
+    _mm_store_ps(lanes[2], min_y);
+    _mm_store_ps(lanes[3], max_y);
+
+    for (int k = 0; k < 4; k++)
+    {
+        bounds.add(lanes[0][k], lanes[2][k]);
+        bounds.add(lanes[1][k], lanes[3][k]);
+    }
+
+    transform_range(t, a, i, count, bounds);
+}
+
+__attribute__((target("avx2")))
+static void transform_avx2(const VertexTransform &t, const TransformArrays &a, const size_t count, ScreenBounds &bounds)
+{
+    const auto &m = t.matrix.m;
+    const auto &r = t.rotation.m;
+    __m256 min_x = _mm256_set1_ps(bounds.min_x), max_x = _mm256_set1_ps(bounds.max_x);
+    __m256 min_y = _mm256_set1_ps(bounds.min_y), max_y = _mm256_set1_ps(bounds.max_y);
+
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        const __m256 x = _mm256_loadu_ps(a.x + i);
+        const __m256 y = _mm256_loadu_ps(a.y + i);
+        const __m256 z = _mm256_loadu_ps(a.z + i);
+
+        const __m256 sx = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(m[0]), x), _mm256_mul_ps(_mm256_set1_ps(m[1]), y)), _mm256_mul_ps(_mm256_set1_ps(m[2]), z)), _mm256_set1_ps(m[3]));
+        const __m256 sy = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(m[4]), x), _mm256_mul_ps(_mm256_set1_ps(m[5]), y)), _mm256_mul_ps(_mm256_set1_ps(m[6]), z)), _mm256_set1_ps(m[7]));
+
+        const __m256 sz = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(m[8]), x), _mm256_mul_ps(_mm256_set1_ps(m[9]), y)), _mm256_mul_ps(_mm256_set1_ps(m[10]), z)), _mm256_set1_ps(m[11]));
+
+        _mm256_storeu_ps(a.sx + i, sx);
+        _mm256_storeu_ps(a.sy + i, sy);
+        _mm256_storeu_ps(a.sz + i, sz);
+
+        if (a.rx)
+        {
+            _mm256_storeu_ps(a.rx + i, _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(r[0]), x), _mm256_mul_ps(_mm256_set1_ps(r[1]), y)), _mm256_mul_ps(_mm256_set1_ps(r[2]), z)));
+            _mm256_storeu_ps(a.ry + i, _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(r[3]), x), _mm256_mul_ps(_mm256_set1_ps(r[4]), y)), _mm256_mul_ps(_mm256_set1_ps(r[5]), z)));
+            _mm256_storeu_ps(a.rz + i, _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(r[6]), x), _mm256_mul_ps(_mm256_set1_ps(r[7]), y)), _mm256_mul_ps(_mm256_set1_ps(r[8]), z)));
+        }
+
+        min_x = _mm256_min_ps(sx, min_x);
+        max_x = _mm256_max_ps(sx, max_x);
+        min_y = _mm256_min_ps(sy, min_y);
+        max_y = _mm256_max_ps(sy, max_y);
+    }
+
+    alignas(32) float lanes[4][8];
+    _mm256_store_ps(lanes[0], min_x);
+    _mm256_store_ps(lanes[1], max_x);
+    _mm256_store_ps(lanes[2], min_y);
+    _mm256_store_ps(lanes[3], max_y);
+
+    for (int k = 0; k < 8; k++)
+    {
+        bounds.add(lanes[0][k], lanes[2][k]);
+        bounds.add(lanes[1][k], lanes[3][k]);
+    }
+
+    transform_range(t, a, i, count, bounds);
+}
+
+__attribute__((target("avx512f")))
+static void transform_avx512(const VertexTransform &t, const TransformArrays &a, const size_t count, ScreenBounds &bounds)
+{
+    const auto &m = t.matrix.m;
+    const auto &r = t.rotation.m;
+    __m512 min_x = _mm512_set1_ps(bounds.min_x), max_x = _mm512_set1_ps(bounds.max_x);
+    __m512 min_y = _mm512_set1_ps(bounds.min_y), max_y = _mm512_set1_ps(bounds.max_y);
+    const __mmask16 all = 0xffff;
+
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16)
+    {
+        const __m512 x = _mm512_loadu_ps(a.x + i);
+        const __m512 y = _mm512_loadu_ps(a.y + i);
+        const __m512 z = _mm512_loadu_ps(a.z + i);
+
+        const __m512 sx = _mm512_add_ps(_mm512_add_ps(_mm512_add_ps(_mm512_mul_ps(_mm512_set1_ps(m[0]), x), _mm512_mul_ps(_mm512_set1_ps(m[1]), y)), _mm512_mul_ps(_mm512_set1_ps(m[2]), z)), _mm512_set1_ps(m[3]));
+        const __m512 sy = _mm512_add_ps(_mm512_add_ps(_mm512_add_ps(_mm512_mul_ps(_mm512_set1_ps(m[4]), x), _mm512_mul_ps(_mm512_set1_ps(m[5]), y)), _mm512_mul_ps(_mm512_set1_ps(m[6]), z)), _mm512_set1_ps(m[7]));
+
+        const __m512 sz = _mm512_add_ps(_mm512_add_ps(_mm512_add_ps(_mm512_mul_ps(_mm512_set1_ps(m[8]), x), _mm512_mul_ps(_mm512_set1_ps(m[9]), y)), _mm512_mul_ps(_mm512_set1_ps(m[10]), z)), _mm512_set1_ps(m[11]));
+
+        _mm512_storeu_ps(a.sx + i, sx);
+        _mm512_storeu_ps(a.sy + i, sy);
+        _mm512_storeu_ps(a.sz + i, sz);
+
+        if (a.rx)
+        {
+            _mm512_storeu_ps(a.rx + i, _mm512_add_ps(_mm512_add_ps(_mm512_mul_ps(_mm512_set1_ps(r[0]), x), _mm512_mul_ps(_mm512_set1_ps(r[1]), y)), _mm512_mul_ps(_mm512_set1_ps(r[2]), z)));
+            _mm512_storeu_ps(a.ry + i, _mm512_add_ps(_mm512_add_ps(_mm512_mul_ps(_mm512_set1_ps(r[3]), x), _mm512_mul_ps(_mm512_set1_ps(r[4]), y)), _mm512_mul_ps(_mm512_set1_ps(r[5]), z)));
+            _mm512_storeu_ps(a.rz + i, _mm512_add_ps(_mm512_add_ps(_mm512_mul_ps(_mm512_set1_ps(r[6]), x), _mm512_mul_ps(_mm512_set1_ps(r[7]), y)), _mm512_mul_ps(_mm512_set1_ps(r[8]), z)));
+        }
+
+        // masked forms over all lanes, unmasked ones pass undefined vector that gcc 12 warns about
+        min_x = _mm512_mask_min_ps(min_x, all, sx, min_x);
+        max_x = _mm512_mask_max_ps(max_x, all, sx, max_x);
+        min_y = _mm512_mask_min_ps(min_y, all, sy, min_y);
+        max_y = _mm512_mask_max_ps(max_y, all, sy, max_y);
+    }
+
+    alignas(64) float lanes[4][16];
+    _mm512_store_ps(lanes[0], min_x);
+    _mm512_store_ps(lanes[1], max_x);
+    _mm512_store_ps(lanes[2], min_y);
+    _mm512_store_ps(lanes[3], max_y);
+
+    for (int k = 0; k < 16; k++)
+    {
+        bounds.add(lanes[0][k], lanes[2][k]);
+        bounds.add(lanes[1][k], lanes[3][k]);
+    }
+
+    transform_range(t, a, i, count, bounds);
+}
+
+#endif
+
+// widest kernel supported by cpu, chosen once
+static std::pair<TransformKernel, const char *> select_kernel()
+{
+#ifdef TRANSFORM_X86
+    __builtin_cpu_init();
+
+    if (__builtin_cpu_supports("avx512f"))
+        return {transform_avx512, "avx512"};
+
+    if (__builtin_cpu_supports("avx2"))
+        return {transform_avx2, "avx2"};
+
+    if (__builtin_cpu_supports("sse2"))
+        return {transform_sse2, "sse2"};
+#endif
+
+    return {transform_scalar, "scalar"};
+}
+
+static const std::pair<TransformKernel, const char *> &kernel()
+{
+    static const auto selected = select_kernel();
+    return selected;
+}
+
+// VertexTransform methods
+
+VertexTransform VertexTransform::orbit(const Camera &cam, const float logical_x, const float logical_y)
+{
+    const Mat4 view = cam.view_matrix();
+
+    // same as Vec3::to_screen
+    const Mat4 viewport = Mat4::affine(
+        Mat3::scale({0.5f * cam.zoom, -0.5f * cam.zoom, 0.5f * cam.zoom}),
+        {0.5f * logical_x, 0.5f * logical_y, 0.5f});
+
+    VertexTransform t;
+    t.rotation = view.linear();
+    t.matrix = viewport * view;
+    return t;
+}
+
+Vec3 VertexTransform::center(const ScreenBounds &bounds, const float logical_x, const float logical_y)
+{
+    // offset that centers the bounding box in logical space
+    const float off_x = (logical_x - (bounds.max_x - bounds.min_x)) * 0.5f - bounds.min_x;
+    const float off_y = (logical_y - (bounds.max_y - bounds.min_y)) * 0.5f - bounds.min_y;
+
+    matrix = Mat4::translation({off_x, off_y, 0.0f}) * matrix;
+    return {off_x, off_y, 0.0f};
+}
+
+ScreenBounds VertexTransform::apply(const PlanarPositions &positions, PlanarPositions *rotated, PlanarPositions &screen) const
+{
+    const size_t count = positions.size();
+
+    auto resize = [count](PlanarPositions &p) {
+        p.x.resize(count);
+        p.y.resize(count);
+        p.z.resize(count);
+    };
+
+    resize(screen);
+    if (rotated)
+    {
+        resize(*rotated);
+    }
+
+    const TransformArrays arrays {
+        positions.x.data(), positions.y.data(), positions.z.data(),
+        rotated ? rotated->x.data() : nullptr, rotated ? rotated->y.data() : nullptr, rotated ? rotated->z.data() : nullptr,
+        screen.x.data(), screen.y.data(), screen.z.data()
+    };
+
+    ScreenBounds bounds;
+    kernel().first(*this, arrays, count, bounds);
+    return bounds;
+}
+
+const char *VertexTransform::kernel_name()
+{
+    return kernel().second;
+}
@@ -0,0 +1,68 @@
+/*
+ * transform.h
+ */
+
+#pragma once
+
+#include <array>
+#include <limits>
+
+#include "entities/geometry/packed.h"
+#include "entities/view/camera.h"
+#include "utils/mathematics.h"
+
+// bounds of screen coordinates
+class ScreenBounds {
+public:
+    float min_x = std::numeric_limits<float>::max();
+    float max_x = -std::numeric_limits<float>::max();
+    float min_y = std::numeric_limits<float>::max();
+    float max_y = -std::numeric_limits<float>::max();
+
+    void add(const float x, const float y)
+    {
+        min_x = std::min(min_x, x);
+        max_x = std::max(max_x, x);
+        min_y = std::min(min_y, y);
+        max_y = std::max(max_y, y);
+    }
+};
+
+// camera rotation, zoom, viewport mapping and centering fused into one affine matrix
+class VertexTransform {
+public:
+    Mat3 rotation;  // into camera space, turns normals
+    Mat4 matrix;    // object space straight onto screen
+
+    // camera view on screen of logical size, mesh not centered yet
+    static VertexTransform orbit(const Camera &cam, float logical_x, float logical_y);
+
+    // moves screen bounds of mesh to middle of logical screen by translating matrix, returns translation
+    Vec3 center(const ScreenBounds &bounds, float logical_x, float logical_y);
+
+    [[nodiscard]] Vec3 rotate(const Vec3 &v) const
+    {
+        const auto &r = rotation.m;
+        return {
+            r[0] * v.x + r[1] * v.y + r[2] * v.z,
+            r[3] * v.x + r[4] * v.y + r[5] * v.z,
+            r[6] * v.x + r[7] * v.y + r[8] * v.z
+        };
+    }
+
+    [[nodiscard]] Vec3 to_screen(const Vec3 &v) const
+    {
+        const auto &m = matrix.m;
+        return {
+            m[0] * v.x + m[1] * v.y + m[2] * v.z + m[3],
+            m[4] * v.x + m[5] * v.y + m[6] * v.z + m[7],
+            m[8] * v.x + m[9] * v.y + m[10] * v.z + m[11]
+        };
+    }
+
+    // transforms all positions in one pass with widest kernel cpu supports, rotated may be null, returns screen bounds
+    ScreenBounds apply(const PlanarPositions &positions, PlanarPositions *rotated, PlanarPositions &screen) const;
+
+    // name of kernel used by apply
+    static const char *kernel_name();
+};
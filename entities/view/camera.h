@@ -23,6 +23,12 @@ public:
         altitude(std::clamp(altitude, -PI / 2, PI / 2)),
         zoom(std::clamp(zoom, ZOOM_MIN, ZOOM_MAX)) {}
 
+    // rotation from object space into camera space, looking down z
+    [[nodiscard]] Mat4 view_matrix() const
+    {
+        return Mat4::affine(Mat3::rotation_x(-altitude) * Mat3::rotation_y(-azimuth), {});
+    }
+
     void rotate_left()
     {
         azimuth  = rad_norm(azimuth  + deg2rad(ANGLE_STEP));
@@ -3,18 +3,35 @@
  */
 
 #include <ncurses.h>
+#include <unistd.h>
 
 #include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <csignal>
 #include <cmath>
+#include <cstdarg>
+#include <cstdio>
+#include <fcntl.h>
 #include <filesystem>
 #include <iostream>
+#include <memory>
+#include <mutex>
 #include <optional>
+#include <sstream>
+#include <thread>
 #include <string>
 #include <vector>
 
+#include "entities/geometry/loader.h"
 #include "entities/geometry/object.h"
+#include "entities/rendering/animation.h"
 #include "entities/rendering/buffer.h"
+#include "entities/rendering/frame_cache.h"
+#include "entities/rendering/output.h"
+#include "entities/rendering/rasterizer.h"
 #include "entities/rendering/renderer.h"
+#include "entities/rendering/scheduler.h"
 #include "config.h"
 #include "version.h"
 
@@ -29,11 +46,28 @@ extern "C" const char *__asan_default_options() {
 
 void init_ncurses()
 {
-    initscr();              // start ncurses mode
+    // keys come from terminal when model is piped in
+    if (!isatty(STDIN_FILENO))
+    {
+        FILE *tty = std::fopen("/dev/tty", "r");
+        if (tty)
+        {
+            newterm(nullptr, stdout, tty);
+        }
+        else
+        {
+            initscr();
+        }
+    }
+    else
+    {
+        initscr();          // start ncurses mode
+    }
+
     noecho();               // disable echoing of typed characters
     curs_set(0);            // hide the cursor
     keypad(stdscr, true);   // enable special keys (arrows, etc.)
-    timeout(1);             // make getch() non-blocking
+    refresh();              // initial clear, frames may be written around curses later
 }
 
 void init_colors(const std::vector<Material> &materials)
@@ -65,6 +99,9 @@ static void print_help()
 {
     std::cout <<
         "Usage: " << APP_NAME << " [OPTIONS] <file.obj>\n"
+        "       " << APP_NAME << " --play <file.objt>\n"
+        "\n"
+        "File may be gzip or zstd compressed, - reads from standard input\n"
         "\n"
         "Options:\n"
         "  -c, --color          Enable colors from .mtl file\n"
@@ -73,6 +110,23 @@ static void print_help()
         "  -x, --invert-x       Flip geometry along X axis\n"
         "  -y, --invert-y       Flip geometry along Y axis\n"
         "  -z, --invert-z       Flip geometry along Z axis\n"
+        "  -t, --threads <n>    Worker threads for parsing and rasterizing, 0 for all cores (default)\n"
+        "  -n, --no-cache       Bypass binary model cache\n"
+        "  -r, --rebuild-cache  Reload model and overwrite its cache\n"
+        "  -w, --weld <eps>     Merge vertices closer than eps, 0 for identical only\n"
+        "  -k, --compact        Store vertices as 16-bit fixed point\n"
+        "  -m, --normals        Shade with vn normals from file when present\n"
+        "  -o, --output <mode>  Terminal output, curses (default) or vt for changed cells in one write\n"
+        "  -e, --frames <MiB>   Memory for frames of revisited views, 0 to disable (default " << FRAME_CACHE_MIB << ")\n"
+        "      --headless       Print one frame as text without terminal and exit\n"
+        "      --bake <path>    Render full turn of model to animation file and exit\n"
+        "      --play <path>    Play animation file on terminal, no model is loaded\n"
+        "      --size <WxH>     Frame size in characters for --headless and --bake (default 80x24)\n"
+        "      --azimuth <deg>  Camera azimuth for --headless, first frame for --bake\n"
+        "      --altitude <deg> Camera altitude for --headless and --bake\n"
+        "      --zoom <x>       Camera zoom for --headless and --bake\n"
+        "      --ansi           Color --headless frame from .mtl file with escape codes\n"
+        "      --file <path>    Write --headless frame to file instead of standard output\n"
         "  -h, --help           Print help\n"
         "  -v, --version        Print version\n"
         "\n"
@@ -100,11 +154,87 @@ struct Args {
     bool invert_x = false;          // -x / --invert-x
     bool invert_y = false;          // -y / --invert-y
     bool invert_z = false;          // -z / --invert-z
+    unsigned int threads = 0;       // -t / --threads
+    bool no_cache = false;          // -n / --no-cache
+    bool rebuild_cache = false;     // -r / --rebuild-cache
+    std::optional<float> weld;      // -w / --weld
+    bool compact = false;           // -k / --compact
+    bool file_normals = false;      // -m / --normals
+    bool vt_output = false;         // -o / --output
+    size_t frame_cache = FRAME_CACHE_MIB;   // -e / --frames, MiB
+
+    // headless frame
+    bool headless = false;          // --headless
+    unsigned int width = 80;        // --size
+    unsigned int height = 24;
+    float azimuth = 0.0f;           // --azimuth, deg
+    float altitude = 0.0f;          // --altitude, deg
+    float zoom = 1.0f;              // --zoom
+    bool ansi = false;              // --ansi
+    std::filesystem::path frame_file;   // --file, empty for standard output
+
+    // prerendered turntable
+    std::filesystem::path bake_file;    // --bake
+    std::filesystem::path play_file;    // --play
 };
 
+// numeric option value
+template<typename T>
+static T parse_number(const int argc, char **argv, int &i, const bool negative = false)
+{
+    const std::string_view option{argv[i]};
+
+    if (i + 1 >= argc)
+    {
+        std::cerr << "error: missing value for " << option << '\n';
+        std::exit(1);
+    }
+
+    const std::string_view value{argv[++i]};
+
+    T n = 0;
+    if (const auto [ptr, ec] = std::from_chars(value.data(), value.data() + value.size(), n); ec != std::errc() || ptr != value.data() + value.size() || (!negative && value.starts_with('-')))
+    {
+        std::cerr << "error: invalid value for " << option << ": " << value << '\n';
+        std::exit(1);
+    }
+
+    return n;
+}
+
+// WxH option value
+static void parse_size(const int argc, char **argv, int &i, unsigned int &width, unsigned int &height)
+{
+    const std::string_view option{argv[i]};
+
+    if (i + 1 >= argc)
+    {
+        std::cerr << "error: missing value for " << option << '\n';
+        std::exit(1);
+    }
+
+    const std::string_view value{argv[++i]};
+    const char *const end = value.data() + value.size();
+
+    const auto [w_end, w_ec] = std::from_chars(value.data(), end, width);
+    const bool valid = w_ec == std::errc() && w_end != end && *w_end == 'x' && [&] {
+        const auto [h_end, h_ec] = std::from_chars(w_end + 1, end, height);
+        return h_ec == std::errc() && h_end == end;
+    }();
+
+    if (!valid || width == 0 || height == 0 || width > FRAME_MAX_SIDE || height > FRAME_MAX_SIDE)
+    {
+        std::cerr << "error: invalid value for " << option << ": " << value << '\n';
+        std::exit(1);
+    }
+}
+
 static Args parse_args(int argc, char **argv)
 {
     Args a;
+    std::string_view headless_option;   // last option that needs --headless
+    std::string_view view_option;       // last option that needs --headless or --bake
+
     for (int i = 1; i < argc; ++i)
     {
         const std::string_view arg{argv[i]};
@@ -148,7 +278,106 @@ static Args parse_args(int argc, char **argv)
         {
             a.invert_z = true;
         }
-        else if (arg[0] != '-')
+        else if (arg == "-t" || arg == "--threads")
+        {
+            a.threads = parse_number<unsigned int>(argc, argv, i);
+        }
+        else if (arg == "-n" || arg == "--no-cache")
+        {
+            a.no_cache = true;
+        }
+        else if (arg == "-r" || arg == "--rebuild-cache")
+        {
+            a.rebuild_cache = true;
+        }
+        else if (arg == "-w" || arg == "--weld")
+        {
+            a.weld = parse_number<float>(argc, argv, i);
+        }
+        else if (arg == "-k" || arg == "--compact")
+        {
+            a.compact = true;
+        }
+        else if (arg == "-m" || arg == "--normals")
+        {
+            a.file_normals = true;
+        }
+        else if (arg == "-o" || arg == "--output")
+        {
+            if (i + 1 >= argc)
+            {
+                std::cerr << "error: missing value for " << arg << '\n';
+                std::exit(1);
+            }
+
+            const std::string_view mode{argv[++i]};
+            if (mode != "curses" && mode != "vt")
+            {
+                std::cerr << "error: invalid value for " << arg << ": " << mode << '\n';
+                std::exit(1);
+            }
+
+            a.vt_output = mode == "vt";
+        }
+        else if (arg == "-e" || arg == "--frames")
+        {
+            a.frame_cache = parse_number<size_t>(argc, argv, i);
+        }
+
+        // headless frame
+        else if (arg == "--headless")
+        {
+            a.headless = true;
+        }
+        else if (arg == "--size")
+        {
+            parse_size(argc, argv, i, a.width, a.height);
+            view_option = arg;
+        }
+        else if (arg == "--azimuth")
+        {
+            a.azimuth = parse_number<float>(argc, argv, i, true);
+            view_option = arg;
+        }
+        else if (arg == "--altitude")
+        {
+            a.altitude = parse_number<float>(argc, argv, i, true);
+            view_option = arg;
+        }
+        else if (arg == "--zoom")
+        {
+            a.zoom = parse_number<float>(argc, argv, i);
+            view_option = arg;
+        }
+        else if (arg == "--ansi")
+        {
+            a.ansi = true;
+            headless_option = arg;
+        }
+        else if (arg == "--file")
+        {
+            if (i + 1 >= argc)
+            {
+                std::cerr << "error: missing value for " << arg << '\n';
+                std::exit(1);
+            }
+
+            a.frame_file = argv[++i];
+            headless_option = arg;
+        }
+
+        // prerendered turntable
+        else if (arg == "--bake" || arg == "--play")
+        {
+            if (i + 1 >= argc)
+            {
+                std::cerr << "error: missing value for " << arg << '\n';
+                std::exit(1);
+            }
+
+            (arg == "--bake" ? a.bake_file : a.play_file) = argv[++i];
+        }
+        else if (arg[0] != '-' || arg == "-")
         {
             if (!a.input_file.empty())
             {
@@ -167,6 +396,36 @@ static Args parse_args(int argc, char **argv)
         }
     }
 
+    if (!a.headless && !headless_option.empty())
+    {
+        std::cerr << "error: " << headless_option << " needs --headless\n";
+        std::exit(1);
+    }
+
+    if (!a.headless && a.bake_file.empty() && !view_option.empty())
+    {
+        std::cerr << "error: " << view_option << " needs --headless or --bake\n";
+        std::exit(1);
+    }
+
+    if (static_cast<int>(a.headless) + !a.bake_file.empty() + !a.play_file.empty() > 1)
+    {
+        std::cerr << "error: --headless, --bake and --play can't be combined\n";
+        std::exit(1);
+    }
+
+    // animation is played without model
+    if (!a.play_file.empty())
+    {
+        if (!a.input_file.empty())
+        {
+            std::cerr << "error: --play takes no input file\n";
+            std::exit(1);
+        }
+
+        return a;
+    }
+
     if (a.input_file.empty())
     {
         std::cerr << "error: no input file\n";
@@ -179,11 +438,51 @@ static Args parse_args(int argc, char **argv)
 
 // helpers
 
-void render_hud(const Camera &cam)
+// printf into string
+__attribute__((format(printf, 1, 2)))
+static std::string format_line(const char *format, ...)
+{
+    char line[256];
+
+    va_list args;
+    va_start(args, format);
+    std::vsnprintf(line, sizeof(line), format, args);
+    va_end(args);
+
+    return line;
+}
+
+// lines of hud, top row first
+std::vector<std::string> render_hud(const Camera &cam, const Buffer &buf, const Object &obj, size_t level, const RasterStats &raster, double output_ms, const OutputStats &output, const FrameCacheStats &cache, const std::optional<WeldStats> &weld)
+{
+    std::vector<std::string> lines;
+
+    lines.push_back(format_line("zoom     %6.1f x",  cam.zoom));
+    lines.push_back(format_line("azimuth  %6.1f deg", clamp0(rad2deg(cam.azimuth))));
+    lines.push_back(format_line("altitude %6.1f deg", clamp0(rad2deg(cam.altitude))));
+    lines.push_back(format_line("level    %4zu / %zu, %zu faces", level, obj.levels.size(), level == 0 ? obj.face_count() : obj.levels[level - 1].face_count()));
+    lines.push_back(format_line("overdraw %6.2f x, %zu / %zu draws hidden", raster.overdraw(), raster.rejected, raster.draws));
+    lines.push_back(format_line("output   %6.2f ms, %zu bytes, %zu writes", output_ms, output.bytes, output.writes));
+    lines.push_back(format_line("cache    %zu hits, %zu misses, %zu frames, %zu KiB", cache.hits, cache.misses, cache.frames, cache.bytes / 1024));
+
+    if (obj.compact)
+    {
+        // quantization error against size of character cell
+        const float cell = std::min(buf.dx, buf.dy) * 2.0f / cam.zoom;
+        lines.push_back(format_line("compact  %zu KiB, error %.4f cells", obj.compact->size() * sizeof(obj.compact->codes[0]) / 1024, obj.compact->max_error() / cell));
+    }
+
+    if (weld)
+    {
+        lines.push_back(format_line("welded   %zu -> %zu verts, -%zu faces", weld->vertices_before, weld->vertices_after, weld->faces_removed));
+    }
+
+    return lines;
+}
+
+std::string render_progress(float progress)
 {
-    mvprintw(0, 0, "zoom     %6.1f x",  cam.zoom);
-    mvprintw(1, 0, "azimuth  %6.1f deg", clamp0(rad2deg(cam.azimuth)));
-    mvprintw(2, 0, "altitude %6.1f deg", clamp0(rad2deg(cam.altitude)));
+    return format_line("loading  %6.1f %%", progress * 100.0f);
 }
 
 bool handle_input(int ch, Camera &cam, bool &hud)
@@ -223,42 +522,197 @@ bool handle_input(int ch, Camera &cam, bool &hud)
     return true;
 }
 
+// loading as requested on command line
+static LoadOptions load_options(const Args &args)
+{
+    LoadOptions options;
+    options.color_support = args.color_support;
+    options.threads = args.threads;
+    options.use_cache = !args.no_cache;
+    options.rebuild_cache = args.rebuild_cache;
+    options.weld = args.weld;
+    options.compact = args.compact;
+    options.file_normals = args.file_normals;
+    options.orientation.flip_faces = args.flip_faces;
+    options.orientation.invert_x = args.invert_x;
+    options.orientation.invert_y = args.invert_y;
+    options.orientation.invert_z = args.invert_z;
+    return options;
+}
+
+// renders single frame as text, curses is never started
+static int run_headless(const Args &args)
+{
+    LoadOptions options = load_options(args);
+    options.color_support = args.color_support || args.ansi;
+    options.levels = false;     // full mesh is drawn once, preparing it for redraws costs more than drawing it
+    options.pack = false;
+    options.progressive = false;
+
+    BackgroundLoader loader;
+    loader.start(args.input_file, options);
+    loader.wait();
+
+    if (loader.failed())
+    {
+        return 1;
+    }
+
+    const float logical_y = 2.0f;
+    const float logical_x = logical_y * static_cast<float>(args.width) / (static_cast<float>(args.height) * CHAR_ASPECT_RATIO);
+
+    Buffer buf(args.width, args.height, logical_x, logical_y);
+    TileRasterizer rasterizer(args.threads);
+    const Camera cam(deg2rad(args.azimuth), deg2rad(args.altitude), args.zoom);
+    const Light light;
+
+    const Object &obj = loader.object();
+    Renderer::render(buf, obj, cam, light, args.static_light, options.color_support, 0, &rasterizer);
+
+    int fd = STDOUT_FILENO;
+    if (!args.frame_file.empty())
+    {
+        fd = ::open(args.frame_file.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0)
+        {
+            std::cerr << "error: can't open file " << args.frame_file.string() << std::endl;
+            return 1;
+        }
+    }
+
+    TextOutput output(fd, args.ansi ? &obj.materials : nullptr);
+    output.present(buf, {});
+
+    if (fd != STDOUT_FILENO)
+    {
+        ::close(fd);
+    }
+
+    if (output.failed())
+    {
+        std::cerr << "error: can't write frame" << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
+
+// renders full turn of camera to animation file, curses is never started
+static int run_bake(const Args &args)
+{
+    LoadOptions options = load_options(args);
+    options.levels = false;     // every frame is drawn from full mesh
+    options.pack = true;        // packed faces pay off over the whole turn
+    options.progressive = false;
+
+    BackgroundLoader loader;
+    loader.start(args.input_file, options);
+    loader.wait();
+
+    if (loader.failed())
+    {
+        return 1;
+    }
+
+    const Camera cam(deg2rad(args.azimuth), deg2rad(args.altitude), args.zoom);
+    const Animation animation = Animation::bake(loader.object(), cam, args.width, args.height, args.static_light, args.color_support, args.threads);
+
+    if (!animation.save(args.bake_file))
+    {
+        std::cerr << "error: can't write file " << args.bake_file.string() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
+
+static volatile std::sig_atomic_t interrupted = 0;
+
+// streams frames of animation file to terminal, cells are only decoded and diffed
+static int run_play(const Args &args)
+{
+    std::optional<Animation> animation = Animation::load(args.play_file);
+    if (!animation)
+    {
+        std::cerr << "error: can't read animation " << args.play_file.string() << std::endl;
+        return 1;
+    }
+
+    // cursor is shown again when interrupted
+    std::signal(SIGINT, [](int) { interrupted = 1; });
+
+    Buffer buf(animation->width, animation->height, 1.0f, 1.0f);
+    bool corrupt = false;
+
+    {
+        TerminalOutput output(STDOUT_FILENO, animation->palette.empty() ? nullptr : &animation->palette);
+        std::ignore = ::write(STDOUT_FILENO, "\x1b[?25l", 6);
+
+        const auto interval = std::chrono::milliseconds(animation->interval_ms);
+        auto next = std::chrono::steady_clock::now();
+
+        for (const auto &frame : animation->frames)
+        {
+            if (interrupted)
+                break;
+
+            if (!Animation::decode(frame, buf.cells))
+            {
+                corrupt = true;
+                break;
+            }
+
+            output.present(buf, {});
+
+            next += interval;
+            std::this_thread::sleep_until(next);
+        }
+    }
+
+    // cursor below animation
+    const std::string restore = "\x1b[" + std::to_string(animation->height + 1) + ";1H\x1b[?25h";
+    std::ignore = ::write(STDOUT_FILENO, restore.data(), restore.size());
+
+    if (corrupt)
+    {
+        std::cerr << "error: corrupt animation " << args.play_file.string() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
+
 // main
 int main(int argc, char **argv)
 {
     const Args args = parse_args(argc, argv);
 
-    // load object
-    Object obj;
-    if (!obj.load(args.input_file.string(), args.color_support))
+    if (args.headless)
     {
-        return 1;
+        return run_headless(args);
     }
 
-    // normalize to unit cube
-    obj.normalize();
-
-    // flip faces winding order
-    if (args.flip_faces)
-        obj.flip_faces();
+    if (!args.bake_file.empty())
+    {
+        return run_bake(args);
+    }
 
-    // invert along axes
-    if (args.invert_x)
-        obj.invert_x();
+    if (!args.play_file.empty())
+    {
+        return run_play(args);
+    }
 
-    if (args.invert_y)
-        obj.invert_y();
+    // diagnostics of background loading are held until curses screen is gone
+    std::ostringstream load_log;
+    std::streambuf *const cerr_buf = std::cerr.rdbuf(load_log.rdbuf());
 
-    if (args.invert_z)
-        obj.invert_z();
+    // load object in background, normalized to unit cube and oriented
+    BackgroundLoader loader;
+    loader.start(args.input_file, load_options(args));
 
     // init curses
     init_ncurses();
 
-    // init colors
-    if (args.color_support)
-        init_colors(obj.materials);
-
     // buffer
     int rows;
     int cols;
@@ -270,40 +724,128 @@ int main(int argc, char **argv)
 
     Buffer buf(static_cast<unsigned int>(cols), static_cast<unsigned int>(rows), logical_x, logical_y);
 
+    // faces are drawn front to back, tiles of screen in parallel when more than one thread is available
+    TileRasterizer rasterizer(args.threads);
+
+    std::unique_ptr<Output> output;
+    if (args.vt_output)
+    {
+        output = std::make_unique<TerminalOutput>(STDOUT_FILENO);
+    }
+    else
+    {
+        output = std::make_unique<CursesOutput>();
+    }
+
+    // frames of camera states seen before, object is drawn again only for new ones
+    FrameCache cache(args.frame_cache << 20);
+
     // view
     Camera cam;         // default
     Light light;        // default
     bool hud = false;
+    size_t colors = 0;  // materials with initialized colors
+    double output_ms = 0.0; // copying buffer to terminal in last frame
+
+    // frames are drawn only when something changed, loading progress is polled as animation
+    FrameScheduler scheduler;
+    unsigned int revision = loader.revision();
 
     // main render loop
-    while (true)
+    while (!loader.failed())
     {
-        // clear buffer
-        buf.clear();
+        if (loader.working())
+        {
+            scheduler.animate(std::chrono::milliseconds(FRAME_INTERVAL_MS));
+        }
+        else
+        {
+            scheduler.stop();
+        }
 
-        // render model
-        Renderer::render(buf, obj, cam, light, args.static_light, args.color_support);
+        // due animation step redraws, progress of loading moves on with it
+        if (scheduler.tick())
+        {
+            scheduler.invalidate();
+        }
 
-        move(0, 0);
-        buf.printw();
+        if (const unsigned int r = loader.revision(); r != revision)
+        {
+            revision = r;
+            scheduler.invalidate();
+            cache.clear();
+        }
 
-        // render hud
-        if (hud)
+        if (scheduler.due())
         {
-            render_hud(cam);
+            // render model, partially loaded one while loading
+            const bool loading = loader.loading();
+            std::unique_lock lock(loader.mutex);
+            const Object &obj = loader.object();
+
+            // init colors
+            if (args.color_support && obj.materials.size() != colors)
+            {
+                init_colors(obj.materials);
+                colors = obj.materials.size();
+                refresh();  // palette reaches terminal before frames written around curses
+            }
+
+            // detail level follows zoom and terminal size
+            const size_t level = Renderer::select_level(obj, buf, cam);
+
+            // frames of model still loading change with every revision, they are not kept
+            const uint64_t key = FrameCache::key(cam, buf);
+            if (loading || !cache.find(key, buf))
+            {
+                buf.clear();
+                Renderer::render(buf, obj, cam, light, args.static_light, args.color_support, level, &rasterizer);
+
+                if (!loading)
+                {
+                    cache.store(key, buf);
+                }
+            }
+
+            // render hud
+            std::vector<std::string> overlay;
+            if (hud)
+            {
+                overlay = render_hud(cam, buf, obj, level, rasterizer.stats(), output_ms, output->stats(), cache.stats(), loading ? std::nullopt : loader.weld_stats());
+            }
+            lock.unlock();
+
+            if (loading)
+            {
+                overlay.push_back(render_progress(loader.progress()));
+            }
+
+            // draw buffer
+            const auto output_start = std::chrono::steady_clock::now();
+            output->present(buf, overlay);
+            scheduler.drawn();
+
+            output_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - output_start).count();
         }
 
-        // draw buffer
-        refresh();
+        // wait for key or next animation step
+        timeout(scheduler.wait_ms());
+        int ch = getch();
+
+        if (ch == ERR)
+        {
+            continue;
+        }
 
         // handle key
-        int ch = getch();
+        scheduler.invalidate();
 
         if (ch == KEY_RESIZE)
         {
             getmaxyx(stdscr, rows, cols);
             const float lx = logical_y * static_cast<float>(cols) / (static_cast<float>(rows) * CHAR_ASPECT_RATIO);
             buf = Buffer(static_cast<unsigned int>(cols), static_cast<unsigned int>(rows), lx, logical_y);
+            output->invalidate();
         }
 
         if (!handle_input(ch, cam, hud))
@@ -312,6 +854,12 @@ int main(int argc, char **argv)
         }
     }
 
+    output.reset();
     endwin();
-    return 0;
+
+    loader.stop();
+    std::cerr.rdbuf(cerr_buf);
+    std::cerr << load_log.str();
+
+    return loader.failed() ? 1 : 0;
 }
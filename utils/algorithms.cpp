@@ -4,53 +4,222 @@
 
 #include "algorithms.h"
 
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
 // helper functions
 
-static bool is_in_triangle(const Vec3 &pt, const Vec3 &v1, const Vec3 &v2, const Vec3 &v3, const Vec3 &normal)
+// polygon projected onto plane of its dominant normal axis, counter-clockwise
+class Polygon2 {
+public:
+    std::vector<float> u, v;
+
+    Polygon2(const std::vector<Vec3> &points, const Vec3 &normal)
+    {
+        const float ax = std::fabs(normal.x);
+        const float ay = std::fabs(normal.y);
+        const float az = std::fabs(normal.z);
+
+        // cyclic axes keep sign of dropped normal component
+        const int axis = (ax >= ay && ax >= az) ? 0 : (ay >= az ? 1 : 2);
+        const float sign = (axis == 0 ? normal.x : axis == 1 ? normal.y : normal.z) < 0.0f ? -1.0f : 1.0f;
+
+        u.reserve(points.size());
+        v.reserve(points.size());
+
+        for (const auto &p : points)
+        {
+            const float c[3] = {p.x, p.y, p.z};
+            u.push_back(c[(axis + 1) % 3]);
+            v.push_back(c[(axis + 2) % 3] * sign);
+        }
+    }
+
+    // twice signed area of triangle, positive if counter-clockwise
+    [[nodiscard]] float orient(const size_t a, const size_t b, const size_t c) const
+    {
+        return (u[b] - u[a]) * (v[c] - v[a]) - (v[b] - v[a]) * (u[c] - u[a]);
+    }
+
+    [[nodiscard]] bool in_triangle(const size_t p, const size_t a, const size_t b, const size_t c) const
+    {
+        return orient(a, b, p) >= 0.0f && orient(b, c, p) >= 0.0f && orient(c, a, p) >= 0.0f;
+    }
+};
+
+// uniform grid over reflex vertices, only they can lie inside an ear
+class ReflexGrid {
+public:
+    ReflexGrid(const Polygon2 &poly, const std::vector<char> &reflex, const size_t count) : poly(poly), reflex(reflex)
+    {
+        min_u = min_v = std::numeric_limits<float>::max();
+        float max_u = -std::numeric_limits<float>::max();
+        float max_v = -std::numeric_limits<float>::max();
+
+        for (size_t i = 0; i < reflex.size(); i++)
+        {
+            if (!reflex[i])
+                continue;
+
+            min_u = std::min(min_u, poly.u[i]);
+            min_v = std::min(min_v, poly.v[i]);
+            max_u = std::max(max_u, poly.u[i]);
+            max_v = std::max(max_v, poly.v[i]);
+        }
+
+        // about one reflex vertex per cell
+        side = std::max<size_t>(1, static_cast<size_t>(std::sqrt(static_cast<float>(count))));
+        scale_u = static_cast<float>(side) / std::max(max_u - min_u, 1e-12f);
+        scale_v = static_cast<float>(side) / std::max(max_v - min_v, 1e-12f);
+        cells.resize(side * side);
+
+        for (size_t i = 0; i < reflex.size(); i++)
+        {
+            if (reflex[i])
+                cells[cell(poly.u[i], scale_u, min_u) * side + cell(poly.v[i], scale_v, min_v)].push_back(i);
+        }
+    }
+
+    // any still reflex vertex except corners inside triangle
+    [[nodiscard]] bool any_inside(const size_t a, const size_t b, const size_t c) const
+    {
+        const size_t u0 = cell(std::min({poly.u[a], poly.u[b], poly.u[c]}), scale_u, min_u);
+        const size_t u1 = cell(std::max({poly.u[a], poly.u[b], poly.u[c]}), scale_u, min_u);
+        const size_t v0 = cell(std::min({poly.v[a], poly.v[b], poly.v[c]}), scale_v, min_v);
+        const size_t v1 = cell(std::max({poly.v[a], poly.v[b], poly.v[c]}), scale_v, min_v);
+
+        for (size_t cu = u0; cu <= u1; cu++)
+        {
+            for (size_t cv = v0; cv <= v1; cv++)
+            {
+                for (const size_t p : cells[cu * side + cv])
+                {
+                    if (reflex[p] && p != a && p != b && p != c && poly.in_triangle(p, a, b, c))
+                        return true;
+                }
+            }
+        }
+
+        return false;
+    }
+
+private:
+    const Polygon2 &poly;
+    const std::vector<char> &reflex;    // flags are cleared as vertices turn convex
+
+    std::vector<std::vector<size_t>> cells;
+    size_t side;
+    float min_u, min_v;
+    float scale_u, scale_v;
+
+    [[nodiscard]] size_t cell(const float value, const float scale, const float min) const
+    {
+        return std::min(side - 1, static_cast<size_t>(std::max(0.0f, (value - min) * scale)));
+    }
+};
+
+// every corner turns the same way, fan is valid
+static bool is_convex(const std::vector<Vec3> &points, const Vec3 &normal)
 {
-    const float s1 = Vec3::dot(Vec3::cross(v2 - v1, pt - v1), normal);
-    const float s2 = Vec3::dot(Vec3::cross(v3 - v2, pt - v2), normal);
-    const float s3 = Vec3::dot(Vec3::cross(v1 - v3, pt - v3), normal);
+    const size_t n = points.size();
 
-    const bool same_sign = (s1 >= 0 && s2 >= 0 && s3 >= 0) || (s1 <= 0 && s2 <= 0 && s3 <= 0);
+    for (size_t i = 0; i < n; i++)
+    {
+        const Vec3 &v1 = points[(i + n - 1) % n];
+        const Vec3 &v2 = points[i];
+        const Vec3 &v3 = points[(i + 1) % n];
+
+        if (Vec3::dot(Vec3::cross(v2 - v1, v3 - v2), normal) <= 0.0f)
+        {
+            return false;
+        }
+    }
 
-    return same_sign;
+    return true;
 }
 
-static bool is_ear(const size_t i, const std::vector<Vec3> &points, const std::vector<size_t> &indices, const Vec3 &normal)
+// fan from last vertex, same triangles ear clipping yields for convex polygon
+static std::vector<size_t> triangularize_fan(const size_t n)
 {
-    const size_t prev = indices[(i + indices.size() - 1) % indices.size()];
-    const size_t curr = indices[i];
-    const size_t next = indices[(i + 1) % indices.size()];
+    std::vector<size_t> result;
+    result.reserve(3 * (n - 2));
+
+    for (size_t i = 0; i + 3 < n; i++)
+    {
+        result.insert(result.end(), {n - 1, i, i + 1});
+    }
+
+    result.insert(result.end(), {n - 3, n - 2, n - 1});
+    return result;
+}
 
-    const Vec3 &v1 = points[prev];
-    const Vec3 &v2 = points[curr];
-    const Vec3 &v3 = points[next];
+// ear clipping over linked list of vertices with reflex vertices in grid
+static std::optional<std::vector<size_t>> triangularize_ears(const std::vector<Vec3> &points, const Vec3 &normal)
+{
+    const size_t n = points.size();
+    const Polygon2 poly(points, normal);
 
-    // check if angle is convex
-    const Vec3 d1 = v2 - v1;
-    const Vec3 d2 = v3 - v2;
+    std::vector<size_t> prev(n);
+    std::vector<size_t> next(n);
+    for (size_t i = 0; i < n; i++)
+    {
+        prev[i] = (i + n - 1) % n;
+        next[i] = (i + 1) % n;
+    }
 
-    if (Vec3::dot(Vec3::cross(d1, d2), normal) <= 0.0f)
+    std::vector<char> reflex(n);
+    size_t reflex_count = 0;
+    for (size_t i = 0; i < n; i++)
     {
-        return false; // not convex
+        reflex[i] = poly.orient(prev[i], i, next[i]) <= 0.0f;
+        reflex_count += reflex[i];
     }
 
-    // check for no other points inside triangle
-    for (size_t j = 0; j < indices.size(); j++)
+    const ReflexGrid grid(poly, reflex, reflex_count);
+
+    std::vector<size_t> result;
+    result.reserve(3 * (n - 2));
+
+    size_t remaining = n;
+    size_t ear = 0;
+    size_t stop = ear;  // full lap without ear means failure
+
+    while (remaining > 3)
     {
-        if (j == (i - 1 + indices.size()) % indices.size() || j == i || j == (i + 1) % indices.size())
+        const size_t a = prev[ear];
+        const size_t b = next[ear];
+
+        if (!reflex[ear] && !grid.any_inside(a, ear, b))
         {
+            // adding triangle
+            result.insert(result.end(), {a, ear, b});
+
+            // removing current ear
+            next[a] = b;
+            prev[b] = a;
+            remaining--;
+
+            // neighbours may turn convex, never back
+            reflex[a] = reflex[a] && poly.orient(prev[a], a, b) <= 0.0f;
+            reflex[b] = reflex[b] && poly.orient(a, b, next[b]) <= 0.0f;
+
+            ear = b;
+            stop = ear;
             continue;
         }
 
-        if (is_in_triangle(points[indices[j]], v1, v2, v3, normal))
+        ear = next[ear];
+        if (ear == stop)
         {
-            return false; // point inside triangle
+            return std::nullopt; // no valid ear
         }
     }
 
-    return true; // ear found
+    // adding last triangle
+    result.insert(result.end(), {prev[ear], ear, next[ear]});
+
+    return result;
 }
 
 // main functions
@@ -60,6 +229,30 @@ float lerp(const float a, const float b, const float t)
     return a + (b - a) * t;
 }
 
+uint64_t hash_bytes(const void *data, const size_t size, const uint64_t seed)
+{
+    constexpr uint64_t prime = 0x9e3779b97f4a7c15ull;
+
+    const auto *p = static_cast<const unsigned char *>(data);
+    uint64_t h = seed ^ (size * prime);
+
+    // word at a time, tail padded with zeros
+    for (size_t i = 0; i < size; i += 8)
+    {
+        uint64_t word = 0;
+        std::memcpy(&word, p + i, std::min<size_t>(8, size - i));
+
+        h ^= word * prime;
+        h = (h << 31 | h >> 33) * prime;
+    }
+
+    // final avalanche
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdull;
+    h ^= h >> 33;
+    return h;
+}
+
 std::optional<std::vector<size_t>> triangularize(const std::vector<Vec3> &points)
 {
     const size_t n = points.size();
@@ -75,49 +268,12 @@ std::optional<std::vector<size_t>> triangularize(const std::vector<Vec3> &points
         return std::nullopt; // degenerate polygon
     }
 
-    // list of vertex indexes
-    std::vector<size_t> indices(n);
-    std::iota(indices.begin(), indices.end(), 0);
-
-    std::vector<size_t> result;
-
-    // ears search
-    while (indices.size() > 3)
+    if (is_convex(points, normal))
     {
-        bool ear_found = false;
-
-        for (std::size_t i = 0; i < indices.size(); i++)
-        {
-            if (is_ear(i, points, indices, normal))
-            {
-                // adding triangle
-                size_t prev = indices[(i + indices.size() - 1) % indices.size()];
-                size_t curr = indices[i];
-                size_t next = indices[(i + 1) % indices.size()];
-
-                result.push_back(prev);
-                result.push_back(curr);
-                result.push_back(next);
-
-                // removing current ear
-                indices.erase(std::next(indices.begin(), static_cast<std::ptrdiff_t>(i)));
-                ear_found = true;
-                break;
-            }
-        }
-
-        if (!ear_found)
-        {
-            return std::nullopt; // no valid ear
-        }
+        return triangularize_fan(n);
     }
 
-    // adding last triangle
-    result.push_back(indices[0]);
-    result.push_back(indices[1]);
-    result.push_back(indices[2]);
-
-    return result;
+    return triangularize_ears(points, normal);
 }
 
 float deg2rad(float degree)
@@ -4,6 +4,8 @@
 
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
 #include <numeric>
 #include <optional>
 #include <vector>
@@ -20,6 +22,9 @@ T clamp(const T &value, const T &low, const T &high)
     return (value < low) ? low : (value > high ? high : value);
 }
 
+// non-cryptographic 64-bit hash of byte range
+uint64_t hash_bytes(const void *data, size_t size, uint64_t seed = 0);
+
 // polygon triangulation
 std::optional<std::vector<size_t>> triangularize(const std::vector<Vec3> &points);
 
@@ -0,0 +1,360 @@
+/*
+ * input_stream.cpp
+ */
+
+#include "input_stream.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+#include "config.h"
+
+// raw input read per system call
+static constexpr size_t RAW_BUFFER_SIZE = 1 << 16;
+
+// decompression state, only one of streams is used
+class InputStream::Decoder {
+public:
+    bool frame_done = false;    // last frame ended cleanly, more may follow
+
+#ifdef HAVE_ZLIB
+    z_stream zs {};
+    bool zs_ready = false;
+#endif
+
+#ifdef HAVE_ZSTD
+    ZSTD_DCtx *dctx = nullptr;
+#endif
+
+    ~Decoder()
+    {
+#ifdef HAVE_ZLIB
+        if (zs_ready)
+            inflateEnd(&zs);
+#endif
+
+#ifdef HAVE_ZSTD
+        ZSTD_freeDCtx(dctx);
+#endif
+    }
+};
+
+InputStream::InputStream() = default;
+
+InputStream::~InputStream()
+{
+    close();
+}
+
+bool InputStream::open(const std::string &filename)
+{
+    close();
+
+    if (filename == "-")
+    {
+        fd = STDIN_FILENO;
+        owned = false;
+    }
+    else
+    {
+        fd = ::open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
+        {
+            return false;
+        }
+        owned = true;
+
+        struct stat st {};
+        if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode))
+        {
+            raw_total = static_cast<uint64_t>(st.st_size);
+        }
+    }
+
+    raw.resize(RAW_BUFFER_SIZE);
+
+    // enough leading bytes for magic numbers
+    while (raw_end < 4 && fill()) {}
+
+    fmt = detect({raw.data(), raw_end});
+    decoder = std::make_unique<Decoder>();
+
+    switch (fmt)
+    {
+        case Format::plain:
+            break;
+
+        case Format::gzip:
+#ifdef HAVE_ZLIB
+            // 32 - detect gzip or zlib header
+            if (inflateInit2(&decoder->zs, 15 + 32) != Z_OK)
+            {
+                message = "can't initialize gzip decoder";
+                return false;
+            }
+            decoder->zs_ready = true;
+#else
+            message = "gzip support not compiled in";
+            return false;
+#endif
+            break;
+
+        case Format::zstd:
+#ifdef HAVE_ZSTD
+            decoder->dctx = ZSTD_createDCtx();
+            if (!decoder->dctx)
+            {
+                message = "can't initialize zstd decoder";
+                return false;
+            }
+#else
+            message = "zstd support not compiled in";
+            return false;
+#endif
+            break;
+    }
+
+    return true;
+}
+
+void InputStream::close()
+{
+    if (owned && fd >= 0)
+    {
+        ::close(fd);
+    }
+
+    fd = -1;
+    owned = false;
+    fmt = Format::plain;
+    decoder.reset();
+    message.clear();
+
+    raw.clear();
+    raw_begin = 0;
+    raw_end = 0;
+    raw_eof = false;
+    raw_total = 0;
+    raw_consumed = 0;
+    interrupted = false;
+}
+
+size_t InputStream::read(char *out, const size_t size)
+{
+    if (fd < 0 || failed() || size == 0)
+    {
+        return 0;
+    }
+
+    switch (fmt)
+    {
+        case Format::gzip:
+            return read_gzip(out, size);
+        case Format::zstd:
+            return read_zstd(out, size);
+        default:
+            return read_plain(out, size);
+    }
+}
+
+float InputStream::progress() const
+{
+    if (raw_total == 0)
+    {
+        return 0.0f;
+    }
+
+    return std::min(1.0f, static_cast<float>(raw_consumed.load(std::memory_order_relaxed)) / static_cast<float>(raw_total));
+}
+
+InputStream::Format InputStream::detect(const std::string_view head)
+{
+    if (head.starts_with("\x1f\x8b"))
+    {
+        return Format::gzip;
+    }
+
+    if (head.starts_with("\x28\xb5\x2f\xfd"))
+    {
+        return Format::zstd;
+    }
+
+    return Format::plain;
+}
+
+bool InputStream::fill()
+{
+    if (raw_eof)
+    {
+        return false;
+    }
+
+    // move pending bytes to front
+    if (raw_begin > 0)
+    {
+        std::memmove(raw.data(), raw.data() + raw_begin, raw_end - raw_begin);
+        raw_end -= raw_begin;
+        raw_begin = 0;
+    }
+
+    if (raw_end == raw.size())
+    {
+        return true;    // buffer full
+    }
+
+    // pipes may stall indefinitely, waiting is cut short to notice interrupt
+    pollfd pfd {fd, POLLIN, 0};
+    while (!interrupted)
+    {
+        const int ready = ::poll(&pfd, 1, LOAD_POLL_MS);
+        if (ready > 0 || (ready < 0 && errno != EINTR))
+            break;
+    }
+
+    if (interrupted)
+    {
+        raw_eof = true;
+        return false;
+    }
+
+    ssize_t n;
+    do
+    {
+        n = ::read(fd, raw.data() + raw_end, raw.size() - raw_end);
+    } while (n < 0 && errno == EINTR);
+
+    if (n < 0)
+    {
+        message = std::string("read failed: ") + std::strerror(errno);
+    }
+
+    if (n <= 0)
+    {
+        raw_eof = true;
+        return false;
+    }
+
+    raw_end += static_cast<size_t>(n);
+    return true;
+}
+
+size_t InputStream::read_plain(char *out, const size_t size)
+{
+    if (raw_begin == raw_end && !fill())
+    {
+        return 0;
+    }
+
+    const size_t n = std::min(size, raw_end - raw_begin);
+    std::memcpy(out, raw.data() + raw_begin, n);
+    raw_begin += n;
+    raw_consumed += n;
+    return n;
+}
+
+size_t InputStream::read_gzip(char *out, const size_t size)
+{
+#ifdef HAVE_ZLIB
+    z_stream &zs = decoder->zs;
+    zs.next_out = reinterpret_cast<Bytef *>(out);
+    zs.avail_out = static_cast<uInt>(std::min<size_t>(size, UINT32_MAX));
+    const uInt capacity = zs.avail_out;
+
+    while (zs.avail_out == capacity)
+    {
+        if (raw_begin == raw_end && !fill())
+        {
+            if (!failed() && !decoder->frame_done)
+            {
+                message = "unexpected end of gzip stream";
+            }
+            break;
+        }
+
+        const size_t available = raw_end - raw_begin;
+        zs.next_in = reinterpret_cast<Bytef *>(raw.data() + raw_begin);
+        zs.avail_in = static_cast<uInt>(available);
+
+        const int ret = inflate(&zs, Z_NO_FLUSH);
+
+        const size_t used = available - zs.avail_in;
+        raw_begin += used;
+        raw_consumed += used;
+
+        if (ret == Z_STREAM_END)
+        {
+            // concatenated members continue after reset
+            decoder->frame_done = true;
+            inflateReset(&zs);
+        }
+        else if (ret == Z_OK || ret == Z_BUF_ERROR)
+        {
+            decoder->frame_done = decoder->frame_done && used == 0;
+        }
+        else
+        {
+            message = "corrupt gzip stream";
+            break;
+        }
+    }
+
+    return capacity - zs.avail_out;
+#else
+    (void)out;
+    (void)size;
+    return 0;
+#endif
+}
+
+size_t InputStream::read_zstd(char *out, const size_t size)
+{
+#ifdef HAVE_ZSTD
+    ZSTD_outBuffer output {out, size, 0};
+
+    while (output.pos == 0)
+    {
+        if (raw_begin == raw_end && !fill())
+        {
+            if (!failed() && !decoder->frame_done)
+            {
+                message = "unexpected end of zstd stream";
+            }
+            break;
+        }
+
+        ZSTD_inBuffer input {raw.data() + raw_begin, raw_end - raw_begin, 0};
+        const size_t ret = ZSTD_decompressStream(decoder->dctx, &output, &input);
+
+        raw_begin += input.pos;
+        raw_consumed += input.pos;
+
+        if (ZSTD_isError(ret))
+        {
+            message = std::string("corrupt zstd stream: ") + ZSTD_getErrorName(ret);
+            break;
+        }
+
+        // 0 - frame is complete and flushed
+        decoder->frame_done = ret == 0;
+    }
+
+    return output.pos;
+#else
+    (void)out;
+    (void)size;
+    return 0;
+#endif
+}
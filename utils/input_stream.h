@@ -0,0 +1,67 @@
+/*
+ * input_stream.h
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// sequential reader of plain, gzip or zstd data from file or standard input ("-")
+class InputStream {
+public:
+    enum class Format { plain, gzip, zstd };
+
+    InputStream();
+    ~InputStream();
+
+    InputStream(const InputStream &) = delete;
+    InputStream &operator=(const InputStream &) = delete;
+
+    // open and detect format from leading bytes
+    bool open(const std::string &filename);
+    void close();
+
+    // read up to size decoded bytes, 0 at end of data, on error or once interrupted
+    size_t read(char *out, size_t size);
+
+    // ends read waiting for input, safe to call from other thread
+    void interrupt() { interrupted = true; }
+
+    [[nodiscard]] bool failed() const { return !message.empty(); }
+    [[nodiscard]] const std::string &error() const { return message; }
+    [[nodiscard]] Format format() const { return fmt; }
+
+    // consumed fraction of raw input, 0 if size is unknown, safe to call from other thread than read
+    [[nodiscard]] float progress() const;
+
+    // compressed format by leading bytes of data
+    static Format detect(std::string_view head);
+
+private:
+    class Decoder;  // state of decompression library
+
+    int fd = -1;
+    bool owned = false;                 // descriptor closed by stream
+    Format fmt = Format::plain;
+    std::unique_ptr<Decoder> decoder;
+    std::string message;
+
+    std::vector<char> raw;              // raw input not yet decoded
+    size_t raw_begin = 0;
+    size_t raw_end = 0;
+    bool raw_eof = false;
+    uint64_t raw_total = 0;             // size of input file, 0 if unknown
+    std::atomic<uint64_t> raw_consumed = 0;
+    std::atomic<bool> interrupted = false;
+
+    bool fill();                        // read more raw input, false at end, on error or once interrupted
+    size_t read_plain(char *out, size_t size);
+    size_t read_gzip(char *out, size_t size);
+    size_t read_zstd(char *out, size_t size);
+};
@@ -0,0 +1,84 @@
+/*
+ * mapped_file.cpp
+ */
+
+#include "mapped_file.h"
+
+#include <utility>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+MappedFile::~MappedFile()
+{
+    close();
+}
+
+MappedFile::MappedFile(MappedFile &&other) noexcept :
+    address(std::exchange(other.address, nullptr)),
+    length(std::exchange(other.length, 0)),
+    opened(std::exchange(other.opened, false)) {}
+
+MappedFile &MappedFile::operator=(MappedFile &&other) noexcept
+{
+    if (this != &other)
+    {
+        close();
+        address = std::exchange(other.address, nullptr);
+        length = std::exchange(other.length, 0);
+        opened = std::exchange(other.opened, false);
+    }
+
+    return *this;
+}
+
+bool MappedFile::open(const std::string &filename)
+{
+    close();
+
+    const int fd = ::open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        return false;
+    }
+
+    struct stat st {};
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode))
+    {
+        ::close(fd);
+        return false;
+    }
+
+    // mmap of zero length is invalid, empty file is just empty view
+    if (st.st_size > 0)
+    {
+        void *ptr = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+        if (ptr == MAP_FAILED)
+        {
+            ::close(fd);
+            return false;
+        }
+
+        madvise(ptr, static_cast<size_t>(st.st_size), MADV_SEQUENTIAL);
+
+        address = static_cast<const char *>(ptr);
+        length = static_cast<size_t>(st.st_size);
+    }
+
+    ::close(fd);    // mapping stays valid after descriptor is closed
+    opened = true;
+    return true;
+}
+
+void MappedFile::close()
+{
+    if (address)
+    {
+        munmap(const_cast<char *>(address), length);
+    }
+
+    address = nullptr;
+    length = 0;
+    opened = false;
+}
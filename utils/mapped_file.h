@@ -0,0 +1,35 @@
+/*
+ * mapped_file.h
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+// read-only memory mapped file
+class MappedFile {
+public:
+    MappedFile() = default;
+    ~MappedFile();
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    MappedFile(MappedFile &&other) noexcept;
+    MappedFile &operator=(MappedFile &&other) noexcept;
+
+    bool open(const std::string &filename);
+    void close();
+
+    [[nodiscard]] bool is_open() const { return opened; }
+    [[nodiscard]] const char *data() const { return address; }
+    [[nodiscard]] size_t size() const { return length; }
+    [[nodiscard]] std::string_view view() const { return {address, length}; }
+
+private:
+    const char *address = nullptr;  // start of mapping, null for empty file
+    size_t length = 0;              // mapping length in bytes
+    bool opened = false;
+};
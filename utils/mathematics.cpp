@@ -130,3 +130,116 @@ Vec3 Vec3::to_screen(const Vec3 &v, float zoom, float logical_x, float logical_y
     };
 }
 
+// Mat3 methods
+
+Mat3 Mat3::identity()
+{
+    return scale({1.0f, 1.0f, 1.0f});
+}
+
+Mat3 Mat3::rotation_y(const float radians)
+{
+    const float cos_theta = std::cos(radians);
+    const float sin_theta = std::sin(radians);
+
+    Mat3 r;
+    r.m = {
+        cos_theta, 0.0f, -sin_theta,
+        0.0f,      1.0f, 0.0f,
+        sin_theta, 0.0f, cos_theta
+    };
+    return r;
+}
+
+Mat3 Mat3::rotation_x(const float radians)
+{
+    const float cos_theta = std::cos(radians);
+    const float sin_theta = std::sin(radians);
+
+    Mat3 r;
+    r.m = {
+        1.0f, 0.0f,      0.0f,
+        0.0f, cos_theta, -sin_theta,
+        0.0f, sin_theta, cos_theta
+    };
+    return r;
+}
+
+Mat3 Mat3::scale(const Vec3 &s)
+{
+    Mat3 r;
+    r.m = {
+        s.x,  0.0f, 0.0f,
+        0.0f, s.y,  0.0f,
+        0.0f, 0.0f, s.z
+    };
+    return r;
+}
+
+Mat3 Mat3::operator*(const Mat3 &other) const
+{
+    Mat3 r;
+    for (int row = 0; row < 3; row++)
+    {
+        for (int col = 0; col < 3; col++)
+        {
+            r.m[row * 3 + col] = m[row * 3] * other.m[col] + m[row * 3 + 1] * other.m[3 + col] + m[row * 3 + 2] * other.m[6 + col];
+        }
+    }
+    return r;
+}
+
+// Mat4 methods
+
+Mat4 Mat4::affine(const Mat3 &linear, const Vec3 &translation)
+{
+    const auto &l = linear.m;
+
+    Mat4 r;
+    r.m = {
+        l[0], l[1], l[2], translation.x,
+        l[3], l[4], l[5], translation.y,
+        l[6], l[7], l[8], translation.z,
+        0.0f, 0.0f, 0.0f, 1.0f
+    };
+    return r;
+}
+
+Mat4 Mat4::translation(const Vec3 &t)
+{
+    return affine(Mat3::identity(), t);
+}
+
+Mat4 Mat4::operator*(const Mat4 &other) const
+{
+    // bottom rows are 0 0 0 1, so translation is carried as another column
+    const Mat3 l = linear() * other.linear();
+    const Vec3 t = transform_point(other.offset());
+    return affine(l, t);
+}
+
+Vec3 Mat4::transform_point(const Vec3 &p) const
+{
+    return {
+        m[0] * p.x + m[1] * p.y + m[2] * p.z + m[3],
+        m[4] * p.x + m[5] * p.y + m[6] * p.z + m[7],
+        m[8] * p.x + m[9] * p.y + m[10] * p.z + m[11]
+    };
+}
+
+Mat3 Mat4::linear() const
+{
+    Mat3 r;
+    r.m = {
+        m[0], m[1], m[2],
+        m[4], m[5], m[6],
+        m[8], m[9], m[10]
+    };
+    return r;
+}
+
+Vec3 Mat4::offset() const
+{
+    return {m[3], m[7], m[11]};
+}
+
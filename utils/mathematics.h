@@ -4,6 +4,7 @@
 
 #pragma once
 
+#include <array>
 #include <cmath>
 #include <vector>
 
@@ -48,3 +49,32 @@ public:
     [[nodiscard]] static Vec3 to_screen(const Vec3 &v, float zoom, float logical_x, float logical_y);   // transform to viewport
 
 };
+
+// 3x3 matrix, row major
+class Mat3 {
+public:
+    std::array<float, 9> m {};
+
+    [[nodiscard]] static Mat3 identity();
+    [[nodiscard]] static Mat3 rotation_y(float radians);    // same as Vec3::rotate_y
+    [[nodiscard]] static Mat3 rotation_x(float radians);    // same as Vec3::rotate_x
+    [[nodiscard]] static Mat3 scale(const Vec3 &s);         // per axis scale
+
+    Mat3 operator*(const Mat3 &other) const;    // applies other first
+};
+
+// affine 4x4 matrix, row major, bottom row is always 0 0 0 1
+class Mat4 {
+public:
+    std::array<float, 16> m {};
+
+    [[nodiscard]] static Mat4 affine(const Mat3 &linear, const Vec3 &translation);
+    [[nodiscard]] static Mat4 translation(const Vec3 &t);
+
+    Mat4 operator*(const Mat4 &other) const;    // applies other first
+
+    [[nodiscard]] Vec3 transform_point(const Vec3 &p) const;    // with translation
+
+    [[nodiscard]] Mat3 linear() const;      // upper left 3x3
+    [[nodiscard]] Vec3 offset() const;      // translation column
+};
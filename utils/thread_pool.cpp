@@ -0,0 +1,96 @@
+/*
+ * thread_pool.cpp
+ */
+
+#include "thread_pool.h"
+
+#include <algorithm>
+
+ThreadPool::ThreadPool(unsigned int threads)
+{
+    if (threads == 0)
+    {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    for (unsigned int i = 1; i < threads; i++)
+    {
+        workers.emplace_back(&ThreadPool::work, this);
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+
+    for (auto &t : workers)
+    {
+        t.join();
+    }
+}
+
+void ThreadPool::run(const size_t count, const std::function<void(size_t)> &job)
+{
+    if (workers.empty() || count <= 1)
+    {
+        for (size_t i = 0; i < count; i++)
+        {
+            job(i);
+        }
+        return;
+    }
+
+    {
+        std::lock_guard lock(mutex);
+        task = &job;
+        task_count = count;
+        next = 0;
+        active = workers.size();
+        batch++;
+    }
+    wake.notify_all();
+
+    drain();    // calling thread takes part too
+
+    std::unique_lock lock(mutex);
+    finished.wait(lock, [this]() { return active == 0; });
+    task = nullptr;
+}
+
+void ThreadPool::work()
+{
+    unsigned int seen = 0;
+
+    while (true)
+    {
+        {
+            std::unique_lock lock(mutex);
+            wake.wait(lock, [this, seen]() { return stopping || batch != seen; });
+            if (stopping)
+            {
+                return;
+            }
+            seen = batch;
+        }
+
+        drain();
+
+        std::lock_guard lock(mutex);
+        if (--active == 0)
+        {
+            finished.notify_one();
+        }
+    }
+}
+
+void ThreadPool::drain()
+{
+    for (size_t i = next++; i < task_count; i = next++)
+    {
+        (*task)(i);
+    }
+}
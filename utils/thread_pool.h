@@ -0,0 +1,45 @@
+/*
+ * thread_pool.h
+ */
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// persistent worker threads running batches of indexed tasks
+class ThreadPool {
+public:
+    explicit ThreadPool(unsigned int threads);  // threads including caller, 0 - all cores
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    [[nodiscard]] unsigned int size() const { return static_cast<unsigned int>(workers.size()) + 1; }
+
+    // task(i) for every i below count on all threads including caller, returns when all are done
+    void run(size_t count, const std::function<void(size_t)> &task);
+
+private:
+    void work();    // worker loop
+    void drain();   // take tasks of current batch until none is left
+
+    std::vector<std::thread> workers;
+
+    std::mutex mutex;
+    std::condition_variable wake;       // new batch or stop
+    std::condition_variable finished;   // last worker left batch
+
+    const std::function<void(size_t)> *task = nullptr;
+    size_t task_count = 0;
+    std::atomic<size_t> next = 0;
+    size_t active = 0;                  // workers still in current batch
+    unsigned int batch = 0;
+    bool stopping = false;
+};